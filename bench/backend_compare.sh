@@ -0,0 +1,86 @@
+#!/bin/sh
+# Backend comparison: runs the same static workloads against phase8 on
+# epoll and on io_uring (-U). Each pair is measured twice: an untraced run
+# gives requests/sec and server CPU per request, a second run under
+# build/syscount gives system calls per request (ptrace slows that run
+# down, so only its per-request counts are used). One JSON line per
+# backend and workload.
+#
+# Environment: PORT (8089), DURATION seconds per run (5), THREADS (1),
+# CONNECTIONS (64), SERVER_ARGS (extra phase8 options, e.g. "-j 2"),
+# SCENARIOS (all, or a space separated list of names)
+set -e
+
+BUILD_DIR=${BUILD_DIR:-build}
+PORT=${PORT:-8089}
+DURATION=${DURATION:-5}
+THREADS=${THREADS:-1}
+CONNECTIONS=${CONNECTIONS:-64}
+SCENARIOS=${SCENARIOS:-"small-keepalive small-close large-keepalive pipelined"}
+ROOT=$BUILD_DIR/bench-root
+
+# Scratch document root so the large file never lands in public/
+rm -rf "$ROOT"
+mkdir -p "$ROOT"
+cp -R public errors "$ROOT"/
+head -c 1048576 /dev/urandom > "$ROOT/public/large.bin"
+
+SERVER_PID=
+stop_server() {
+    if [ -n "$SERVER_PID" ]; then
+        kill $SERVER_PID 2>/dev/null || true
+        wait $SERVER_PID 2>/dev/null || true
+        SERVER_PID=
+    fi
+}
+trap stop_server EXIT INT TERM
+
+# start_server [tracer...] -- backend options
+start_server() {
+    (cd "$ROOT" && exec "$@" -p $PORT -a off -r 1000000 -k 60 $SERVER_ARGS > server.log 2>&1) &
+    SERVER_PID=$!
+    sleep 0.5
+}
+
+json_field() {
+    sed -n "s/.*\"$1\":\([0-9.]*\).*/\1/p"
+}
+
+run() {
+    label=$1
+    shift
+    case " $SCENARIOS " in
+        *" $label "*) ;;
+        *) return 0 ;;
+    esac
+    for backend in epoll io_uring; do
+        flag=
+        if [ $backend = io_uring ]; then
+            flag=-U
+        fi
+
+        start_server ../phase8_eventdriven $flag
+        result=$(./$BUILD_DIR/loadgen -p $PORT -t $THREADS -d $DURATION -s $SERVER_PID -l "$label" "$@")
+        stop_server
+
+        start_server ../syscount -o syscalls.txt ../phase8_eventdriven $flag
+        traced=$(./$BUILD_DIR/loadgen -p $PORT -t $THREADS -d $DURATION -l "$label" "$@")
+        stop_server
+
+        requests=$(echo "$traced" | json_field requests)
+        top=$(awk -v requests="$requests" 'NR > 1 && NR <= 6 {
+                  printf "%s\"%s\":%.2f", (NR > 2 ? "," : ""), $2, $1 / requests
+              }' "$ROOT/syscalls.txt")
+        total=$(awk 'NR == 1 { print $1 }' "$ROOT/syscalls.txt")
+        echo "$result" | awk -v backend=$backend -v total="$total" -v requests="$requests" -v top="$top" '{
+            sub(/}$/, "")
+            printf "%s,\"backend\":\"%s\",\"syscalls_per_request\":%.2f,\"top_syscalls_per_request\":{%s}}\n",
+                   $0, backend, total / requests, top
+        }'
+    done
+}
+
+run small-keepalive -c $CONNECTIONS -m "1:GET:/index.html"
+run small-close     -c $CONNECTIONS -C -m "1:GET:/index.html"
+run large-keepalive -c 16 -m "1:GET:/large.bin"
+run pipelined       -c $CONNECTIONS -P 8 -m "1:GET:/index.html"
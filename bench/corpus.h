@@ -0,0 +1,79 @@
+#ifndef BENCH_CORPUS_H
+#define BENCH_CORPUS_H
+
+// Request heads shared by the parser benchmarks and the fuzz seeds:
+// what curl, browsers and cookie- or query-heavy clients actually send
+
+typedef struct {
+    const char *name;
+    const char *request;
+} Sample;
+
+static const Sample samples[] = {
+    { "curl",
+      "GET /index.html HTTP/1.1\r\n"
+      "Host: localhost:8080\r\n"
+      "User-Agent: curl/8.5.0\r\n"
+      "Accept: */*\r\n"
+      "\r\n" },
+    { "browser",
+      "GET /style.css?v=3 HTTP/1.1\r\n"
+      "Host: localhost:8080\r\n"
+      "Connection: keep-alive\r\n"
+      "sec-ch-ua: \"Chromium\";v=\"124\", \"Google Chrome\";v=\"124\", \"Not-A.Brand\";v=\"99\"\r\n"
+      "sec-ch-ua-mobile: ?0\r\n"
+      "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/124.0.0.0 Safari/537.36\r\n"
+      "sec-ch-ua-platform: \"Linux\"\r\n"
+      "Accept: text/css,*/*;q=0.1\r\n"
+      "Sec-Fetch-Site: same-origin\r\n"
+      "Sec-Fetch-Mode: no-cors\r\n"
+      "Sec-Fetch-Dest: style\r\n"
+      "Referer: http://localhost:8080/\r\n"
+      "Accept-Encoding: gzip, deflate, br, zstd\r\n"
+      "Accept-Language: en-US,en;q=0.9\r\n"
+      "\r\n" },
+    { "firefox",
+      "GET /search?q=epoll+edge+triggered%20vs%20level&client=firefox-b-d HTTP/1.1\r\n"
+      "Host: localhost:8080\r\n"
+      "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:125.0) Gecko/20100101 Firefox/125.0\r\n"
+      "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8\r\n"
+      "Accept-Language: en-US,en;q=0.5\r\n"
+      "Accept-Encoding: gzip, deflate, br\r\n"
+      "DNT: 1\r\n"
+      "Connection: keep-alive\r\n"
+      "Upgrade-Insecure-Requests: 1\r\n"
+      "Sec-Fetch-Dest: document\r\n"
+      "Sec-Fetch-Mode: navigate\r\n"
+      "Sec-Fetch-Site: none\r\n"
+      "Sec-Fetch-User: ?1\r\n"
+      "Priority: u=1\r\n"
+      "\r\n" },
+    { "cookie",
+      "GET /app/dashboard HTTP/1.1\r\n"
+      "Host: example.com\r\n"
+      "User-Agent: Mozilla/5.0 (Macintosh; Intel Mac OS X 14_4) AppleWebKit/605.1.15 (KHTML, like Gecko) Version/17.4 Safari/605.1.15\r\n"
+      "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+      "Cookie: session=8f14e45fceea167a5a36dedd4bea2543; _ga=GA1.1.1234567890.1700000000; "
+      "_gid=GA1.1.987654321.1700000000; theme=dark; lang=en; cart=%5B%7B%22id%22%3A42%7D%5D; "
+      "prefs=eyJ0eiI6IkV1cm9wZS9CZXJsaW4iLCJ1bml0cyI6Im1ldHJpYyJ9\r\n"
+      "Accept-Language: en-GB,en;q=0.9\r\n"
+      "Accept-Encoding: gzip, deflate, br\r\n"
+      "Connection: keep-alive\r\n"
+      "\r\n" },
+    { "params",
+      "GET /api/items?page=2&per_page=50&sort=created_at&order=desc&status=open&status=pending"
+      "&tag=c&tag=networking&tag=epoll&author=alice&since=2024-01-01T00%3A00%3A00Z"
+      "&until=2024-12-31T23%3A59%3A59Z&q=event+loop+%22edge+triggered%22&fields=id%2Cname%2Cupdated_at"
+      "&include=comments&include=labels&lang=en&region=eu&currency=EUR&utm_source=newsletter"
+      "&utm_medium=email&utm_campaign=spring&ref=home&debug=0 HTTP/1.1\r\n"
+      "Host: api.example.com\r\n"
+      "User-Agent: python-requests/2.31.0\r\n"
+      "Accept: application/json\r\n"
+      "Accept-Encoding: gzip, deflate\r\n"
+      "Connection: keep-alive\r\n"
+      "\r\n" },
+};
+
+#define SAMPLE_COUNT (sizeof(samples) / sizeof(samples[0]))
+
+#endif
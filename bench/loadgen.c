@@ -0,0 +1,583 @@
+// HTTP load generator: threads x epoll-driven connections replaying a
+// weighted mix of requests against a local server for a fixed time.
+// Prints one JSON object (throughput, latency quantiles, status counts,
+// CPU per request) so results can be collected and compared across commits
+// Build with `make bench` (which also runs the scenario suite)
+#define _GNU_SOURCE
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "../src/metrics.h"
+
+#define MAX_MIX 32
+#define MAX_PIPELINE 64
+#define REQUEST_SIZE 512
+#define RECEIVE_SIZE (64 * 1024)
+#define MAX_EVENTS 256
+
+typedef struct {
+    int weight;
+    int is_head;
+    char request[REQUEST_SIZE];     // Complete request text
+    size_t request_len;
+    char close_request[REQUEST_SIZE];  // Same with Connection: close
+    size_t close_request_len;
+} MixEntry;
+
+typedef struct {
+    const char *host;
+    int port;
+    int threads;
+    int connections;
+    int duration;
+    int pipeline;
+    int keep_alive;
+    pid_t server_pid;
+    const char *label;
+    const char *run_id;
+    MixEntry mix[MAX_MIX];
+    int mix_count;
+    int mix_total_weight;
+} LoadConfig;
+
+static LoadConfig config = { "127.0.0.1", 8080, 1, 16, 5, 1, 1, 0, "run", "", { { 0 } }, 0, 0 };
+
+static struct sockaddr_in server_addr;
+static volatile int stop_requested;
+
+// Per-thread results, merged at the end
+typedef struct {
+    Histogram latency;
+    uint64_t requests;
+    uint64_t errors;
+    uint64_t connects;
+    uint64_t bytes;
+    uint64_t status_classes[6];     // Index = status / 100
+} Results;
+
+typedef struct {
+    int fd;
+    int connected;
+
+    char out[MAX_PIPELINE * REQUEST_SIZE];
+    size_t out_len;
+    size_t out_sent;
+
+    // Outstanding responses, oldest first
+    int heads[MAX_PIPELINE];
+    int pending;
+    int next_response;
+    uint64_t sent_ns;               // When the batch (or, with close, the connect) started
+
+    char in[RECEIVE_SIZE];
+    size_t in_len;
+    long long body_remaining;       // -1 while reading the response head
+    int status;                     // Of the response being read
+    int server_closes;              // Response said Connection: close
+} Client;
+
+typedef struct {
+    pthread_t thread;
+    int epoll_fd;
+    int client_count;
+    Client *clients;
+    uint64_t random_state;
+    Results results;
+} Worker;
+
+static uint64_t next_random(Worker *worker) {
+    // xorshift64
+    uint64_t x = worker->random_state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    worker->random_state = x;
+    return x;
+}
+
+static const MixEntry *pick_request(Worker *worker) {
+    int ticket = (int)(next_random(worker) % config.mix_total_weight);
+    for (int i = 0; i < config.mix_count; i++) {
+        ticket -= config.mix[i].weight;
+        if (ticket < 0) {
+            return &config.mix[i];
+        }
+    }
+    return &config.mix[config.mix_count - 1];
+}
+
+// Queue the next batch: pipeline requests, or one with Connection: close
+static void queue_batch(Worker *worker, Client *client) {
+    int count = config.keep_alive ? config.pipeline : 1;
+    client->out_len = 0;
+    client->out_sent = 0;
+    for (int i = 0; i < count; i++) {
+        const MixEntry *entry = pick_request(worker);
+        const char *request = config.keep_alive ? entry->request : entry->close_request;
+        size_t len = config.keep_alive ? entry->request_len : entry->close_request_len;
+        memcpy(client->out + client->out_len, request, len);
+        client->out_len += len;
+        client->heads[i] = entry->is_head;
+    }
+    client->pending = count;
+    client->next_response = 0;
+    client->body_remaining = -1;
+    client->server_closes = 0;
+    if (client->connected) {
+        client->sent_ns = metrics_now();
+    }
+}
+
+static int open_connection(Worker *worker, Client *client) {
+    client->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (client->fd < 0) {
+        return -1;
+    }
+    int one = 1;
+    setsockopt(client->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    client->connected = 0;
+    client->in_len = 0;
+    // With close, every request pays for its connection, so time it from here
+    client->sent_ns = metrics_now();
+    if (connect(client->fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0 &&
+        errno != EINPROGRESS) {
+        close(client->fd);
+        return -1;
+    }
+    struct epoll_event event;
+    event.events = EPOLLIN | EPOLLOUT | EPOLLET;
+    event.data.ptr = client;
+    if (epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, client->fd, &event) < 0) {
+        close(client->fd);
+        return -1;
+    }
+    worker->results.connects++;
+    queue_batch(worker, client);
+    return 0;
+}
+
+static void reconnect(Worker *worker, Client *client, int failed) {
+    if (failed) {
+        worker->results.errors++;
+    }
+    close(client->fd);
+    while (!stop_requested && open_connection(worker, client) < 0) {
+        worker->results.errors++;
+        usleep(1000);
+    }
+}
+
+// Value of a header in a response head, or NULL
+static const char *find_header(const char *head, const char *end, const char *name) {
+    size_t name_len = strlen(name);
+    const char *line = memchr(head, '\n', end - head);
+    while (line && line + 1 < end) {
+        line++;
+        if ((size_t)(end - line) > name_len && strncasecmp(line, name, name_len) == 0 &&
+            line[name_len] == ':') {
+            const char *value = line + name_len + 1;
+            while (value < end && *value == ' ') {
+                value++;
+            }
+            return value;
+        }
+        line = memchr(line, '\n', end - line);
+    }
+    return NULL;
+}
+
+// Consume complete responses from in[]
+// Returns -1 on a malformed response, 1 when the batch is finished
+static int process_input(Worker *worker, Client *client) {
+    size_t pos = 0;
+    int finished = 0;
+    while (!finished && pos < client->in_len) {
+        if (client->body_remaining < 0) {
+            char *start = client->in + pos;
+            char *end = memmem(start, client->in_len - pos, "\r\n\r\n", 4);
+            if (!end) {
+                if (client->in_len - pos == sizeof(client->in)) {
+                    return -1;  // Head larger than the whole buffer
+                }
+                break;
+            }
+            end += 4;
+            int status = 0;
+            if (end - start < 12 || strncmp(start, "HTTP/1.", 7) != 0 ||
+                (status = atoi(start + 9)) < 100 || status > 599) {
+                return -1;
+            }
+            client->status = status;
+            const char *length = find_header(start, end, "Content-Length");
+            const char *connection = find_header(start, end, "Connection");
+            if (connection && strncasecmp(connection, "close", 5) == 0) {
+                client->server_closes = 1;
+            }
+            client->body_remaining = client->heads[client->next_response] || !length ? 0 : atoll(length);
+            pos = end - client->in;
+        }
+        size_t available = client->in_len - pos;
+        size_t take = available < (size_t)client->body_remaining ? available : (size_t)client->body_remaining;
+        pos += take;
+        client->body_remaining -= take;
+        if (client->body_remaining == 0) {
+            // One response complete: its latency runs from the batch start
+            uint64_t now = metrics_now();
+            int bucket = metrics_bucket(now - client->sent_ns);
+            worker->results.latency.counts[bucket]++;
+            worker->results.latency.total++;
+            worker->results.latency.sum_ns += now - client->sent_ns;
+            worker->results.requests++;
+            worker->results.status_classes[client->status / 100]++;
+            client->body_remaining = -1;
+            client->next_response++;
+            finished = client->next_response == client->pending;
+        }
+    }
+    memmove(client->in, client->in + pos, client->in_len - pos);
+    client->in_len -= pos;
+    return finished;
+}
+
+// Write what is queued and read what has arrived until the socket would block
+static void drive(Worker *worker, Client *client) {
+    while (!stop_requested) {
+        if (!client->connected) {
+            int error = 0;
+            socklen_t len = sizeof(error);
+            getsockopt(client->fd, SOL_SOCKET, SO_ERROR, &error, &len);
+            if (error) {
+                reconnect(worker, client, 1);
+                return;
+            }
+            client->connected = 1;
+            if (config.keep_alive) {
+                client->sent_ns = metrics_now();
+            }
+        }
+
+        while (client->out_sent < client->out_len) {
+            ssize_t written = send(client->fd, client->out + client->out_sent,
+                                   client->out_len - client->out_sent, MSG_NOSIGNAL);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOTCONN) {
+                    break;
+                }
+                reconnect(worker, client, 1);
+                return;
+            }
+            client->out_sent += written;
+        }
+
+        ssize_t bytes_read = read(client->fd, client->in + client->in_len, sizeof(client->in) - client->in_len);
+        if (bytes_read < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOTCONN) {
+                return;
+            }
+            reconnect(worker, client, 1);
+            return;
+        }
+        if (bytes_read == 0) {
+            // Fine between batches (keep-alive limit or idle timeout), an error mid-batch
+            reconnect(worker, client, client->next_response < client->pending);
+            return;
+        }
+        worker->results.bytes += bytes_read;
+        client->in_len += bytes_read;
+
+        int result = process_input(worker, client);
+        if (result < 0) {
+            reconnect(worker, client, 1);
+            return;
+        }
+        if (result == 1) {
+            if (!config.keep_alive || client->server_closes) {
+                reconnect(worker, client, 0);
+                return;
+            }
+            queue_batch(worker, client);
+        }
+    }
+}
+
+static void *worker_main(void *arg) {
+    Worker *worker = arg;
+    struct epoll_event events[MAX_EVENTS];
+    for (int i = 0; i < worker->client_count; i++) {
+        if (open_connection(worker, &worker->clients[i]) < 0) {
+            perror("connect");
+            worker->results.errors++;
+            worker->clients[i].fd = -1;
+        }
+    }
+    while (!stop_requested) {
+        int ready = epoll_wait(worker->epoll_fd, events, MAX_EVENTS, 100);
+        for (int i = 0; i < ready && !stop_requested; i++) {
+            drive(worker, events[i].data.ptr);
+        }
+    }
+    for (int i = 0; i < worker->client_count; i++) {
+        if (worker->clients[i].fd >= 0) {
+            close(worker->clients[i].fd);
+        }
+    }
+    return NULL;
+}
+
+// utime + stime of a process and its children (the workers of a master), in ticks
+static unsigned long long process_ticks(pid_t pid) {
+    unsigned long long total = 0;
+    DIR *proc = opendir("/proc");
+    if (!proc) {
+        return 0;
+    }
+    struct dirent *dirent;
+    while ((dirent = readdir(proc)) != NULL) {
+        if (!isdigit((unsigned char)dirent->d_name[0])) {
+            continue;
+        }
+        char path[300];
+        char stat[1024];
+        snprintf(path, sizeof(path), "/proc/%s/stat", dirent->d_name);
+        FILE *file = fopen(path, "r");
+        if (!file) {
+            continue;
+        }
+        size_t len = fread(stat, 1, sizeof(stat) - 1, file);
+        fclose(file);
+        stat[len] = '\0';
+        // Fields after the parenthesised command name: state ppid ... utime(14) stime(15)
+        char *fields = strrchr(stat, ')');
+        int this_pid = atoi(dirent->d_name);
+        int ppid = 0;
+        unsigned long long utime = 0;
+        unsigned long long stime = 0;
+        if (!fields || sscanf(fields + 2, "%*c %d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu",
+                              &ppid, &utime, &stime) != 3) {
+            continue;
+        }
+        if (this_pid == pid || ppid == pid) {
+            total += utime + stime;
+        }
+    }
+    closedir(proc);
+    return total;
+}
+
+static double client_cpu_seconds(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+static double quantile_us(const Histogram *histogram, double quantile) {
+    if (histogram->total == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(quantile * histogram->total + 0.5);
+    if (rank == 0) {
+        rank = 1;
+    }
+    uint64_t cumulative = 0;
+    for (int b = 0; b < METRICS_BUCKETS; b++) {
+        cumulative += histogram->counts[b];
+        if (cumulative >= rank) {
+            return metrics_bucket_upper_bound(b) / 1e3;
+        }
+    }
+    return 0;
+}
+
+// "weight:METHOD:path,..." e.g. "80:GET:/index.html,20:HEAD:/"
+static int parse_mix(const char *spec) {
+    char *copy = strdup(spec);
+    char *saveptr = NULL;
+    for (char *item = strtok_r(copy, ",", &saveptr); item; item = strtok_r(NULL, ",", &saveptr)) {
+        char method[16];
+        char path[256];
+        int weight;
+        if (config.mix_count == MAX_MIX ||
+            sscanf(item, "%d:%15[^:]:%255s", &weight, method, path) != 3 || weight <= 0) {
+            fprintf(stderr, "Bad mix entry: %s\n", item);
+            free(copy);
+            return -1;
+        }
+        MixEntry *entry = &config.mix[config.mix_count++];
+        entry->weight = weight;
+        entry->is_head = strcmp(method, "HEAD") == 0;
+        entry->request_len = snprintf(entry->request, sizeof(entry->request),
+            "%s %s HTTP/1.1\r\nHost: %s:%d\r\nUser-Agent: loadgen\r\n\r\n",
+            method, path, config.host, config.port);
+        entry->close_request_len = snprintf(entry->close_request, sizeof(entry->close_request),
+            "%s %s HTTP/1.1\r\nHost: %s:%d\r\nUser-Agent: loadgen\r\nConnection: close\r\n\r\n",
+            method, path, config.host, config.port);
+        config.mix_total_weight += weight;
+    }
+    free(copy);
+    return config.mix_count > 0 ? 0 : -1;
+}
+
+static void print_usage(const char *program) {
+    fprintf(stderr,
+        "Usage: %s [-H host] [-p port] [-t threads] [-c connections] [-d seconds] [-P depth] [-C]\n"
+        "          [-m mix] [-s server_pid] [-l label] [-i run_id]\n"
+        "  -H host        Server address (default %s)\n"
+        "  -p port        Server port (default %d)\n"
+        "  -t threads     Load generator threads (default %d)\n"
+        "  -c connections Concurrent connections, spread over the threads (default %d)\n"
+        "  -d seconds     Test duration (default %d)\n"
+        "  -P depth       Requests pipelined per batch on keep-alive connections (default 1)\n"
+        "  -C             Connection: close - one request per connection\n"
+        "  -m mix         weight:METHOD:path,... (default 1:GET:/)\n"
+        "  -s server_pid  Measure the CPU time of this process and its children (workers)\n"
+        "  -l label       Scenario name in the output\n"
+        "  -i run_id      Run identifier in the output, e.g. a commit hash\n",
+        program, config.host, config.port, config.threads, config.connections, config.duration);
+}
+
+int main(int argc, char *argv[]) {
+    const char *mix = "1:GET:/";
+    int opt;
+    while ((opt = getopt(argc, argv, "H:p:t:c:d:P:Cm:s:l:i:h")) != -1) {
+        switch (opt) {
+        case 'H':
+            config.host = optarg;
+            break;
+        case 'p':
+            config.port = atoi(optarg);
+            break;
+        case 't':
+            config.threads = atoi(optarg);
+            break;
+        case 'c':
+            config.connections = atoi(optarg);
+            break;
+        case 'd':
+            config.duration = atoi(optarg);
+            break;
+        case 'P':
+            config.pipeline = atoi(optarg);
+            break;
+        case 'C':
+            config.keep_alive = 0;
+            break;
+        case 'm':
+            mix = optarg;
+            break;
+        case 's':
+            config.server_pid = atoi(optarg);
+            break;
+        case 'l':
+            config.label = optarg;
+            break;
+        case 'i':
+            config.run_id = optarg;
+            break;
+        default:
+            print_usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (config.threads <= 0 || config.connections < config.threads || config.duration <= 0 ||
+        config.pipeline <= 0 || config.pipeline > MAX_PIPELINE || parse_mix(mix) < 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(config.port);
+    if (inet_pton(AF_INET, config.host, &server_addr.sin_addr) != 1) {
+        fprintf(stderr, "Bad address: %s\n", config.host);
+        return 1;
+    }
+
+    Worker *workers = calloc(config.threads, sizeof(Worker));
+    Client *clients = calloc(config.connections, sizeof(Client));
+    if (!workers || !clients) {
+        perror("calloc");
+        return 1;
+    }
+    unsigned long long server_ticks = config.server_pid ? process_ticks(config.server_pid) : 0;
+    double client_cpu = client_cpu_seconds();
+    uint64_t start = metrics_now();
+
+    int assigned = 0;
+    for (int i = 0; i < config.threads; i++) {
+        Worker *worker = &workers[i];
+        worker->client_count = config.connections / config.threads + (i < config.connections % config.threads);
+        worker->clients = clients + assigned;
+        assigned += worker->client_count;
+        worker->random_state = 0x9e3779b97f4a7c15ULL * (i + 1);
+        worker->epoll_fd = epoll_create1(0);
+        if (worker->epoll_fd < 0 || pthread_create(&worker->thread, NULL, worker_main, worker) != 0) {
+            perror("worker start");
+            return 1;
+        }
+    }
+    sleep(config.duration);
+    stop_requested = 1;
+
+    Results total;
+    memset(&total, 0, sizeof(total));
+    for (int i = 0; i < config.threads; i++) {
+        pthread_join(workers[i].thread, NULL);
+        close(workers[i].epoll_fd);
+        Results *results = &workers[i].results;
+        for (int b = 0; b < METRICS_BUCKETS; b++) {
+            total.latency.counts[b] += results->latency.counts[b];
+        }
+        total.latency.total += results->latency.total;
+        total.latency.sum_ns += results->latency.sum_ns;
+        total.requests += results->requests;
+        total.errors += results->errors;
+        total.connects += results->connects;
+        total.bytes += results->bytes;
+        for (int c = 0; c < 6; c++) {
+            total.status_classes[c] += results->status_classes[c];
+        }
+    }
+    double elapsed = (metrics_now() - start) / 1e9;
+    client_cpu = client_cpu_seconds() - client_cpu;
+    double server_cpu = config.server_pid ?
+        (process_ticks(config.server_pid) - server_ticks) / (double)sysconf(_SC_CLK_TCK) : 0;
+    double requests = total.requests > 0 ? (double)total.requests : 1;
+
+    printf("{\"label\":\"%s\",\"run\":\"%s\",\"threads\":%d,\"connections\":%d,\"pipeline\":%d,"
+           "\"keep_alive\":%s,\"mix\":\"%s\",\"seconds\":%.3f,"
+           "\"requests\":%llu,\"errors\":%llu,\"connects\":%llu,\"bytes\":%llu,\"rps\":%.1f,"
+           "\"latency_us\":{\"mean\":%.1f,\"p50\":%.1f,\"p99\":%.1f,\"p999\":%.1f,\"max\":%.1f},"
+           "\"status\":{\"2xx\":%llu,\"3xx\":%llu,\"4xx\":%llu,\"5xx\":%llu},"
+           "\"server_cpu_us_per_request\":%.2f,\"client_cpu_us_per_request\":%.2f}\n",
+           config.label, config.run_id, config.threads, config.connections, config.pipeline,
+           config.keep_alive ? "true" : "false", mix, elapsed,
+           (unsigned long long)total.requests, (unsigned long long)total.errors,
+           (unsigned long long)total.connects, (unsigned long long)total.bytes, total.requests / elapsed,
+           total.latency.sum_ns / requests / 1e3, quantile_us(&total.latency, 0.5),
+           quantile_us(&total.latency, 0.99), quantile_us(&total.latency, 0.999),
+           quantile_us(&total.latency, 1.0),
+           (unsigned long long)total.status_classes[2], (unsigned long long)total.status_classes[3],
+           (unsigned long long)total.status_classes[4], (unsigned long long)total.status_classes[5],
+           config.server_pid ? server_cpu * 1e6 / requests : 0, client_cpu * 1e6 / requests);
+    free(clients);
+    free(workers);
+    return total.requests > 0 ? 0 : 1;
+}
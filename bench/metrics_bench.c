@@ -0,0 +1,61 @@
+// Metrics recording microbenchmark: what phase8 pays per timestamp,
+// histogram sample and response counter
+// Build and run with `make bench-metrics`
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include "../src/metrics.h"
+
+// Keeps the compiler from discarding the timestamps
+static volatile uint64_t sink;
+
+static double per_op(uint64_t start, long iterations) {
+    return (double)(metrics_now() - start) / iterations;
+}
+
+int main(int argc, char *argv[]) {
+    long iterations = argc > 1 ? atol(argv[1]) : 10000000;
+    if (iterations <= 0) {
+        fprintf(stderr, "Usage: %s [iterations]\n", argv[0]);
+        return 1;
+    }
+    if (metrics_init(1) < 0) {
+        perror("metrics_init");
+        return 1;
+    }
+
+    uint64_t start = metrics_now();
+    for (long i = 0; i < iterations; i++) {
+        sink += metrics_now();
+    }
+    printf("%-32s %8.1f ns/op\n", "metrics_now", per_op(start, iterations));
+
+    // Spread the samples over many buckets, as real latencies would be
+    start = metrics_now();
+    for (long i = 0; i < iterations; i++) {
+        metrics_record(STAGE_REQUEST_TOTAL, (uint64_t)(i * 2654435761u) & 0xffffff);
+    }
+    printf("%-32s %8.1f ns/op\n", "metrics_record", per_op(start, iterations));
+
+    start = metrics_now();
+    for (long i = 0; i < iterations; i++) {
+        metrics_count_response(METHOD_GET, 200 + (i & 0xff));
+    }
+    printf("%-32s %8.1f ns/op\n", "metrics_count_response", per_op(start, iterations));
+
+    // What one stage costs in the server: a timestamp plus a sample
+    start = metrics_now();
+    uint64_t previous = start;
+    for (long i = 0; i < iterations; i++) {
+        uint64_t now = metrics_now();
+        metrics_record(STAGE_READ_TO_PARSED, now - previous);
+        previous = now;
+    }
+    printf("%-32s %8.1f ns/op\n", "metrics_now + metrics_record", per_op(start, iterations));
+
+    static char text[64 * 1024];
+    start = metrics_now();
+    int len = metrics_render(text, sizeof(text));
+    printf("%-32s %8.1f us (%d bytes)\n", "metrics_render", (metrics_now() - start) / 1e3, len);
+    return 0;
+}
@@ -0,0 +1,101 @@
+// MIME lookup microbenchmark: the phase5 strcmp chain against the
+// generated perfect-hash table in mime.c
+// Build and run with `make bench-mime`
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../src/mime.h"
+
+// Content-Type detection as in phase5 and the earlier phase8
+static const char *detect_content_type(const char *file_path) {
+    const char *content_type = "application/octet-stream";  // Default for unknown types
+    const char *ext = strrchr(file_path, '.');
+    if(ext){
+        if(strcmp(ext, ".html") == 0 || strcmp(ext, ".htm") == 0){
+            content_type = "text/html";
+        }else if(strcmp(ext, ".css") == 0){
+            content_type = "text/css";
+        }else if(strcmp(ext, ".js") == 0){
+            content_type = "application/javascript";
+        }else if(strcmp(ext, ".json") == 0){
+            content_type = "application/json";
+        }else if(strcmp(ext, ".xml") == 0){
+            content_type = "application/xml";
+        }else if(strcmp(ext, ".png") == 0){
+            content_type = "image/png";
+        }else if(strcmp(ext, ".jpg") == 0 || strcmp(ext, ".jpeg") == 0){
+            content_type = "image/jpeg";
+        }else if(strcmp(ext, ".gif") == 0){
+            content_type = "image/gif";
+        }else if(strcmp(ext, ".svg") == 0){
+            content_type = "image/svg+xml";
+        }else if(strcmp(ext, ".ico") == 0){
+            content_type = "image/x-icon";
+        }else if(strcmp(ext, ".txt") == 0){
+            content_type = "text/plain";
+        }else if(strcmp(ext, ".pdf") == 0){
+            content_type = "application/pdf";
+        }else if(strcmp(ext, ".zip") == 0){
+            content_type = "application/zip";
+        }
+    }
+    return content_type;
+}
+
+// Early in the chain, late in the chain, and past its end
+static const char *paths[] = {
+    "./public/index.html",
+    "./public/style.css",
+    "./public/app/main.js",
+    "./public/img/logo.png",
+    "./public/img/photo.JPEG",
+    "./public/docs/manual.pdf",
+    "./public/downloads/release.zip",
+    "./public/fonts/inter.woff2",
+    "./public/img/hero.webp",
+    "./public/app/module.wasm",
+    "./public/video/intro.mp4",
+    "./public/README",
+};
+
+#define PATH_COUNT (sizeof(paths) / sizeof(paths[0]))
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Keeps the compiler from discarding the lookups
+static volatile size_t sink;
+
+static double bench(const char *(*lookup)(const char *), const char *path, long iterations) {
+    double start = now_ns();
+    for (long i = 0; i < iterations; i++) {
+        sink += (size_t)lookup(path);
+    }
+    return (now_ns() - start) / iterations;
+}
+
+int main(int argc, char *argv[]) {
+    long iterations = argc > 1 ? atol(argv[1]) : 2000000;
+    if (iterations <= 0) {
+        fprintf(stderr, "Usage: %s [iterations]\n", argv[0]);
+        return 1;
+    }
+
+    printf("%-32s %12s %12s  %s\n", "path", "chain ns/op", "table ns/op", "table result");
+    double chain_total = 0;
+    double table_total = 0;
+    for (size_t i = 0; i < PATH_COUNT; i++) {
+        double chain = bench(detect_content_type, paths[i], iterations);
+        double table = bench(mime_type_for_path, paths[i], iterations);
+        chain_total += chain;
+        table_total += table;
+        printf("%-32s %12.1f %12.1f  %s\n", paths[i], chain, table, mime_type_for_path(paths[i]));
+    }
+    printf("%-32s %12.1f %12.1f\n", "average", chain_total / PATH_COUNT, table_total / PATH_COUNT);
+    return 0;
+}
@@ -0,0 +1,123 @@
+// Parser microbenchmark: phase5's sscanf + parse_http_headers against
+// http_parser.c with each scanning implementation the CPU supports
+// Build and run with `make bench-parser`
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../src/http_parser.h"
+#include "../src/http_scan.h"
+#include "../src/phase5_parsing.h"
+#include "corpus.h"
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Keeps the compiler from discarding the parse results
+static volatile int sink;
+
+static double bench_baseline(const char *request, long iterations) {
+    static HttpRequest parsed;
+    char method[16], path[256], version[16];
+    double start = now_ns();
+    for (long i = 0; i < iterations; i++) {
+        sscanf(request, "%15s %255s %15s", method, path, version);
+        sink += parse_http_headers(request, &parsed) + path[0];
+    }
+    return (now_ns() - start) / iterations;
+}
+
+static double bench_parser(const char *request, size_t len, size_t chunk, long iterations) {
+    HttpParserLimits limits = { 1024, 8191, HTTP_MAX_HEADERS, 1024 * 1024 };
+    HttpParser parser;
+    double start = now_ns();
+    for (long i = 0; i < iterations; i++) {
+        http_parser_init(&parser);
+        HttpParseResult result = HTTP_PARSE_INCOMPLETE;
+        // Feed the request in chunk sized reads, as a slow client would
+        for (size_t got = chunk; result == HTTP_PARSE_INCOMPLETE; got += chunk) {
+            result = http_parser_execute(&parser, request, got < len ? got : len, &limits);
+        }
+        sink += parser.header_count + (int)parser.target.length;
+    }
+    return (now_ns() - start) / iterations;
+}
+
+// Decode the request target of a sample, as process_request does
+static double bench_url_decode(const HttpParser *parser, const char *request, int use_baseline, long iterations) {
+    char path[1024];
+    size_t len = parser->target.length;
+    double start = now_ns();
+    for (long i = 0; i < iterations; i++) {
+        if (use_baseline) {
+            memcpy(path, request + parser->target.offset, len);
+            path[len] = '\0';
+            url_decode(path);
+        } else {
+            http_url_decode(path, request + parser->target.offset, len);
+        }
+        sink += path[0];
+    }
+    return (now_ns() - start) / iterations;
+}
+
+int main(int argc, char *argv[]) {
+    long iterations = argc > 1 ? atol(argv[1]) : 200000;
+    if (iterations <= 0) {
+        fprintf(stderr, "Usage: %s [iterations]\n", argv[0]);
+        return 1;
+    }
+
+    const char *implementations[] = { "scalar", "sse2", "avx2" };
+    size_t implementation_count = sizeof(implementations) / sizeof(implementations[0]);
+    printf("Default scanning implementation: %s\n", http_scan_implementation());
+    printf("Whole request head, ns/op (split = fed in 64 byte reads)\n");
+    printf("%-8s %6s %10s", "sample", "bytes", "sscanf");
+    for (size_t k = 0; k < implementation_count; k++) {
+        printf(" %10s %10s", implementations[k], "split");
+    }
+    printf("\n");
+
+    for (size_t i = 0; i < SAMPLE_COUNT; i++) {
+        const char *request = samples[i].request;
+        size_t len = strlen(request);
+        printf("%-8s %6zu %10.1f", samples[i].name, len, bench_baseline(request, iterations));
+        for (size_t k = 0; k < implementation_count; k++) {
+            if (!http_scan_select(implementations[k])) {
+                printf(" %10s %10s", "-", "-");
+                continue;
+            }
+            printf(" %10.1f %10.1f", bench_parser(request, len, len, iterations),
+                   bench_parser(request, len, 64, iterations));
+        }
+        printf("\n");
+    }
+
+    printf("\nRequest target decode, ns/op\n");
+    printf("%-8s %6s %10s", "sample", "bytes", "url_decode");
+    for (size_t k = 0; k < implementation_count; k++) {
+        printf(" %10s", implementations[k]);
+    }
+    printf("\n");
+    HttpParserLimits limits = { 1024, 8191, HTTP_MAX_HEADERS, 1024 * 1024 };
+    for (size_t i = 0; i < SAMPLE_COUNT; i++) {
+        HttpParser parser;
+        http_parser_init(&parser);
+        http_parser_execute(&parser, samples[i].request, strlen(samples[i].request), &limits);
+        printf("%-8s %6u %10.1f", samples[i].name, parser.target.length,
+               bench_url_decode(&parser, samples[i].request, 1, iterations));
+        for (size_t k = 0; k < implementation_count; k++) {
+            if (!http_scan_select(implementations[k])) {
+                printf(" %10s", "-");
+                continue;
+            }
+            printf(" %10.1f", bench_url_decode(&parser, samples[i].request, 0, iterations));
+        }
+        printf("\n");
+    }
+    return 0;
+}
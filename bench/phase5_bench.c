@@ -0,0 +1,92 @@
+// Microbenchmark for the phase5 parsing helpers in src/phase5_parsing.c:
+// parse_http_headers, url_decode and parse_query_string over the request
+// corpus in corpus.h. Reports ns/op, input bytes/op and MB/s per function
+// Build and run with `make bench-phase5`
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../src/phase5_parsing.h"
+#include "corpus.h"
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Keeps the compiler from discarding the results
+static volatile int sink;
+
+typedef enum {
+    COPY_ONLY,          // Cost of refreshing the in-place input, subtracted below
+    URL_DECODE,
+    QUERY_STRING
+} InPlaceFunction;
+
+// url_decode and parse_query_string modify their input, so every
+// iteration starts from a fresh copy
+static double bench_in_place(InPlaceFunction function, const char *input, size_t len, long iterations) {
+    static QueryString query;
+    char buffer[1024];
+    double start = now_ns();
+    for (long i = 0; i < iterations; i++) {
+        memcpy(buffer, input, len + 1);
+        if (function == URL_DECODE) {
+            url_decode(buffer);
+        } else if (function == QUERY_STRING) {
+            sink += parse_query_string(buffer, &query);
+        }
+        sink += buffer[0];
+    }
+    return (now_ns() - start) / iterations;
+}
+
+static double bench_headers(const char *request, long iterations) {
+    static HttpRequest parsed;
+    double start = now_ns();
+    for (long i = 0; i < iterations; i++) {
+        sink += parse_http_headers(request, &parsed);
+    }
+    return (now_ns() - start) / iterations;
+}
+
+static void report(const char *function, const char *sample, double ns, size_t bytes) {
+    printf("%-20s %-8s %10.1f %10zu %10.1f\n", function, sample, ns, bytes, ns > 0 ? bytes / ns * 1e3 : 0);
+}
+
+int main(int argc, char *argv[]) {
+    long iterations = argc > 1 ? atol(argv[1]) : 500000;
+    if (iterations <= 0) {
+        fprintf(stderr, "Usage: %s [iterations]\n", argv[0]);
+        return 1;
+    }
+
+    printf("%-20s %-8s %10s %10s %10s\n", "function", "sample", "ns/op", "bytes/op", "MB/s");
+    for (size_t i = 0; i < SAMPLE_COUNT; i++) {
+        const char *request = samples[i].request;
+        report("parse_http_headers", samples[i].name, bench_headers(request, iterations), strlen(request));
+    }
+
+    for (size_t i = 0; i < SAMPLE_COUNT; i++) {
+        // The request target, as phase5's sscanf extracts it
+        char target[1024];
+        if (sscanf(samples[i].request, "%*s %1023s", target) != 1) {
+            continue;
+        }
+        size_t len = strlen(target);
+        double copy = bench_in_place(COPY_ONLY, target, len, iterations);
+        report("url_decode", samples[i].name,
+               bench_in_place(URL_DECODE, target, len, iterations) - copy, len);
+
+        char decoded[1024];
+        memcpy(decoded, target, len + 1);
+        url_decode(decoded);
+        size_t decoded_len = strlen(decoded);
+        copy = bench_in_place(COPY_ONLY, decoded, decoded_len, iterations);
+        report("parse_query_string", samples[i].name,
+               bench_in_place(QUERY_STRING, decoded, decoded_len, iterations) - copy, decoded_len);
+    }
+    return 0;
+}
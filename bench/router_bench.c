@@ -0,0 +1,143 @@
+// Router microbenchmark: lookups in tries of 1k to 100k routes - literal
+// paths, parameters and wildcards - which should cost about the same at
+// every size, against a first-match scan of the same patterns
+// Build and run with `make bench-router`
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/metrics.h"
+#include "../src/router.h"
+
+#define LOOKUPS 1000000
+#define PATH_SIZE 96
+
+// Route i, in one of four shapes
+static void format_pattern(char *buf, long i) {
+    switch (i & 3) {
+    case 0:
+        snprintf(buf, PATH_SIZE, "/pages/section%ld/page%ld.html", i % 97, i);
+        break;
+    case 1:
+        snprintf(buf, PATH_SIZE, "/api/v1/resource%ld/:id", i);
+        break;
+    case 2:
+        snprintf(buf, PATH_SIZE, "/api/v1/resource%ld/:id/items/:item", i);
+        break;
+    default:
+        snprintf(buf, PATH_SIZE, "/static/bundle%ld/*path", i);
+        break;
+    }
+}
+
+// A request path route i matches (or, with miss set, that nothing matches)
+static void format_path(char *buf, long i, int miss) {
+    switch (i & 3) {
+    case 0:
+        snprintf(buf, PATH_SIZE, "/pages/section%ld/page%ld.%s", i % 97, i, miss ? "htm" : "html");
+        break;
+    case 1:
+        snprintf(buf, PATH_SIZE, "/api/v1/resource%ld%s/42", i, miss ? "x" : "");
+        break;
+    case 2:
+        snprintf(buf, PATH_SIZE, "/api/v1/resource%ld/42/%s/7", i, miss ? "item" : "items");
+        break;
+    default:
+        snprintf(buf, PATH_SIZE, "/static/bundle%ld%s/js/app.min.js", i, miss ? "-old" : "");
+        break;
+    }
+}
+
+// The same pattern syntax, matched directly against the path
+static int pattern_matches(const char *pattern, const char *path) {
+    while (*pattern) {
+        if (*pattern == '*') {
+            return 1;
+        }
+        if (*pattern == ':') {
+            if (*path == '\0' || *path == '/') {
+                return 0;
+            }
+            pattern += strcspn(pattern, "/");
+            path += strcspn(path, "/");
+        } else if (*pattern++ != *path++) {
+            return 0;
+        }
+    }
+    return *path == '\0';
+}
+
+static void run(long routes) {
+    char (*patterns)[PATH_SIZE] = malloc(routes * PATH_SIZE);
+    char (*paths)[PATH_SIZE] = malloc(2 * routes * PATH_SIZE);
+    if (!patterns || !paths) {
+        perror("malloc");
+        exit(1);
+    }
+    Router router;
+    router_init(&router);
+    uint64_t start = metrics_now();
+    for (long i = 0; i < routes; i++) {
+        format_pattern(patterns[i], i);
+        if (router_add(&router, ROUTER_METHOD_BIT(ROUTER_GET), patterns[i], patterns[i]) < 0) {
+            perror(patterns[i]);
+            exit(1);
+        }
+    }
+    double build = (double)(metrics_now() - start) / routes;
+    for (long i = 0; i < routes; i++) {
+        format_path(paths[2 * i], i, 0);
+        format_path(paths[2 * i + 1], i, 1);
+    }
+
+    // Hits and misses in a scattered order, so the trie is not walked warm
+    RouteMatch match;
+    long found[2] = { 0, 0 };
+    double per_lookup[2];
+    for (int miss = 0; miss < 2; miss++) {
+        start = metrics_now();
+        for (long n = 0; n < LOOKUPS; n++) {
+            long i = (n * 7919) % routes;
+            found[miss] += router_match(&router, ROUTER_GET, paths[2 * i + miss], &match);
+        }
+        per_lookup[miss] = (double)(metrics_now() - start) / LOOKUPS;
+    }
+    if (found[0] != LOOKUPS || found[1] != 0) {
+        fprintf(stderr, "%ld routes: %ld of %d hits, %ld false hits\n", routes, found[0], LOOKUPS, found[1]);
+        exit(1);
+    }
+
+    // The scan is linear in the routes, so it gets fewer lookups
+    long scans = 20000000 / routes;
+    long scanned = 0;
+    start = metrics_now();
+    for (long n = 0; n < scans; n++) {
+        const char *path = paths[2 * ((n * 7919) % routes)];
+        for (long i = 0; i < routes; i++) {
+            if (pattern_matches(patterns[i], path)) {
+                scanned++;
+                break;
+            }
+        }
+    }
+    double scan = (double)(metrics_now() - start) / scans;
+    if (scanned != scans) {
+        fprintf(stderr, "%ld routes: the scan found %ld of %ld\n", routes, scanned, scans);
+        exit(1);
+    }
+
+    printf("%7ld routes %8d nodes  add %6.0f ns  hit %5.0f ns  miss %5.0f ns  linear scan %10.0f ns\n",
+           routes, router.node_count, build, per_lookup[0], per_lookup[1], scan);
+    router_free(&router);
+    free(patterns);
+    free(paths);
+}
+
+int main(void) {
+    printf("Router lookup per request path (%d lookups per size)\n", LOOKUPS);
+    long sizes[] = { 1000, 10000, 100000 };
+    for (int i = 0; i < 3; i++) {
+        run(sizes[i]);
+    }
+    return 0;
+}
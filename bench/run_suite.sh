@@ -0,0 +1,58 @@
+#!/bin/sh
+# Benchmark suite: starts phase8 on a scratch copy of public/ (plus a large
+# file), runs build/loadgen once per scenario and prints one JSON line each.
+# The lines are also appended to build/bench-results.jsonl, tagged with the
+# current commit, so runs can be compared across builds.
+#
+# Environment: PORT (8089), DURATION seconds per scenario (5), THREADS (1),
+# CONNECTIONS (64), WORKERS (0 = single process), SCENARIOS (all, or a
+# space separated list of names)
+set -e
+
+BUILD_DIR=${BUILD_DIR:-build}
+PORT=${PORT:-8089}
+DURATION=${DURATION:-5}
+THREADS=${THREADS:-1}
+CONNECTIONS=${CONNECTIONS:-64}
+WORKERS=${WORKERS:-0}
+SCENARIOS=${SCENARIOS:-"small-keepalive small-close large-keepalive notfound head pipelined mixed"}
+RESULTS=$BUILD_DIR/bench-results.jsonl
+ROOT=$BUILD_DIR/bench-root
+RUN_ID=$(git rev-parse --short HEAD 2>/dev/null || echo unknown)
+if [ -n "$(git status --porcelain --untracked-files=no 2>/dev/null)" ]; then
+    RUN_ID="$RUN_ID-dirty"
+fi
+
+# Scratch document root so the large file never lands in public/
+rm -rf "$ROOT"
+mkdir -p "$ROOT"
+cp -R public errors "$ROOT"/
+head -c 1048576 /dev/urandom > "$ROOT/public/large.bin"
+
+SERVER_ARGS="-p $PORT -a off -r 1000000 -k 60"
+if [ "$WORKERS" -gt 0 ]; then
+    SERVER_ARGS="$SERVER_ARGS -w $WORKERS"
+fi
+(cd "$ROOT" && exec ../phase8_eventdriven $SERVER_ARGS > server.log 2>&1) &
+SERVER_PID=$!
+trap 'kill $SERVER_PID 2>/dev/null; wait $SERVER_PID 2>/dev/null || true' EXIT INT TERM
+sleep 0.5
+
+run() {
+    label=$1
+    shift
+    case " $SCENARIOS " in
+        *" $label "*) ;;
+        *) return 0 ;;
+    esac
+    ./$BUILD_DIR/loadgen -p $PORT -t $THREADS -d $DURATION -s $SERVER_PID -l "$label" -i "$RUN_ID" "$@" |
+        tee -a "$RESULTS"
+}
+
+run small-keepalive -c $CONNECTIONS -m "1:GET:/index.html"
+run small-close     -c $CONNECTIONS -C -m "1:GET:/index.html"
+run large-keepalive -c 16 -m "1:GET:/large.bin"
+run notfound        -c $CONNECTIONS -m "1:GET:/missing.html"
+run head            -c $CONNECTIONS -m "1:HEAD:/index.html"
+run pipelined       -c $CONNECTIONS -P 8 -m "1:GET:/index.html"
+run mixed           -c $CONNECTIONS -m "60:GET:/index.html,10:GET:/style.css,5:GET:/large.bin,15:GET:/missing.html,10:HEAD:/"
@@ -0,0 +1,172 @@
+// System call counter: runs a command under ptrace and counts the system
+// calls made by all of its threads and child processes, like `strace -c -f`
+// (without needing strace). SIGINT/SIGTERM are passed on to the command;
+// the counts are written when the last traced task has exited.
+// Used by bench/backend_compare.sh; build with `make bench-backends`
+#define _GNU_SOURCE
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ptrace.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <linux/ptrace.h>
+
+#define MAX_SYSCALL 512
+
+static unsigned long long counts[MAX_SYSCALL];
+static pid_t child;
+
+static const struct {
+    int number;
+    const char *name;
+} syscall_names[] = {
+    { SYS_read, "read" }, { SYS_write, "write" }, { SYS_open, "open" }, { SYS_close, "close" },
+    { SYS_stat, "stat" }, { SYS_fstat, "fstat" }, { SYS_newfstatat, "newfstatat" }, { SYS_statx, "statx" },
+    { SYS_openat, "openat" }, { SYS_pread64, "pread64" }, { SYS_readv, "readv" }, { SYS_writev, "writev" },
+    { SYS_sendfile, "sendfile" }, { SYS_splice, "splice" }, { SYS_pipe2, "pipe2" },
+    { SYS_accept, "accept" }, { SYS_accept4, "accept4" }, { SYS_recvfrom, "recvfrom" },
+    { SYS_sendto, "sendto" }, { SYS_sendmsg, "sendmsg" }, { SYS_recvmsg, "recvmsg" },
+    { SYS_shutdown, "shutdown" }, { SYS_getpeername, "getpeername" }, { SYS_setsockopt, "setsockopt" },
+    { SYS_epoll_wait, "epoll_wait" }, { SYS_epoll_pwait, "epoll_pwait" }, { SYS_epoll_ctl, "epoll_ctl" },
+    { SYS_io_uring_enter, "io_uring_enter" }, { SYS_io_uring_setup, "io_uring_setup" },
+    { SYS_io_uring_register, "io_uring_register" }, { SYS_futex, "futex" }, { SYS_mmap, "mmap" },
+    { SYS_munmap, "munmap" }, { SYS_brk, "brk" }, { SYS_madvise, "madvise" }, { SYS_clock_gettime, "clock_gettime" },
+    { SYS_getpid, "getpid" }, { SYS_rt_sigreturn, "rt_sigreturn" }, { SYS_rt_sigprocmask, "rt_sigprocmask" },
+    { SYS_inotify_add_watch, "inotify_add_watch" }, { SYS_eventfd2, "eventfd2" }, { SYS_lseek, "lseek" },
+    { SYS_execve, "execve" }, { SYS_mprotect, "mprotect" }, { SYS_rt_sigaction, "rt_sigaction" },
+    { SYS_clone, "clone" }, { SYS_clone3, "clone3" }, { SYS_wait4, "wait4" }, { SYS_exit, "exit" },
+    { SYS_exit_group, "exit_group" }, { SYS_ioctl, "ioctl" }, { SYS_fcntl, "fcntl" }, { SYS_poll, "poll" },
+    { SYS_kill, "kill" }, { SYS_nanosleep, "nanosleep" }, { SYS_clock_nanosleep, "clock_nanosleep" },
+};
+
+static const char *syscall_name(int number) {
+    for (size_t i = 0; i < sizeof(syscall_names) / sizeof(syscall_names[0]); i++) {
+        if (syscall_names[i].number == number) {
+            return syscall_names[i].name;
+        }
+    }
+    return NULL;
+}
+
+static void forward_signal(int signo) {
+    kill(child, signo);
+}
+
+static void write_counts(FILE *out) {
+    unsigned long long total = 0;
+    for (int i = 0; i < MAX_SYSCALL; i++) {
+        total += counts[i];
+    }
+    fprintf(out, "%12llu total\n", total);
+    // Largest first
+    while (1) {
+        int largest = -1;
+        for (int i = 0; i < MAX_SYSCALL; i++) {
+            if (counts[i] > 0 && (largest < 0 || counts[i] > counts[largest])) {
+                largest = i;
+            }
+        }
+        if (largest < 0) {
+            break;
+        }
+        const char *name = syscall_name(largest);
+        if (name) {
+            fprintf(out, "%12llu %s\n", counts[largest], name);
+        } else {
+            fprintf(out, "%12llu syscall_%d\n", counts[largest], largest);
+        }
+        counts[largest] = 0;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    const char *output = NULL;
+    int first = 1;
+    if (argc > 2 && strcmp(argv[1], "-o") == 0) {
+        output = argv[2];
+        first = 3;
+    }
+    if (first >= argc) {
+        fprintf(stderr, "Usage: %s [-o file] command [args...]\n", argv[0]);
+        return 1;
+    }
+
+    child = fork();
+    if (child < 0) {
+        perror("fork");
+        return 1;
+    }
+    if (child == 0) {
+        ptrace(PTRACE_TRACEME, 0, NULL, NULL);
+        raise(SIGSTOP);
+        execvp(argv[first], argv + first);
+        perror(argv[first]);
+        _exit(127);
+    }
+
+    int status;
+    if (waitpid(child, &status, 0) < 0 || !WIFSTOPPED(status)) {
+        perror("waitpid");
+        return 1;
+    }
+    long options = PTRACE_O_TRACESYSGOOD | PTRACE_O_TRACECLONE | PTRACE_O_TRACEFORK |
+                   PTRACE_O_TRACEVFORK | PTRACE_O_EXITKILL;
+    if (ptrace(PTRACE_SETOPTIONS, child, NULL, (void *)options) < 0) {
+        perror("ptrace");
+        return 1;
+    }
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = forward_signal;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    int live = 1;
+    ptrace(PTRACE_SYSCALL, child, NULL, NULL);
+    while (live > 0) {
+        pid_t pid = waitpid(-1, &status, __WALL);
+        if (pid < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (WIFEXITED(status) || WIFSIGNALED(status)) {
+            live--;
+            continue;
+        }
+        if (!WIFSTOPPED(status)) {
+            continue;
+        }
+        int signo = WSTOPSIG(status);
+        int event = status >> 16;
+        int inject = 0;
+        if (signo == (SIGTRAP | 0x80)) {
+            struct ptrace_syscall_info info;
+            if (ptrace(PTRACE_GET_SYSCALL_INFO, pid, (void *)sizeof(info), &info) > 0 &&
+                info.op == PTRACE_SYSCALL_INFO_ENTRY && info.entry.nr < MAX_SYSCALL) {
+                counts[info.entry.nr]++;
+            }
+        } else if (event == PTRACE_EVENT_CLONE || event == PTRACE_EVENT_FORK || event == PTRACE_EVENT_VFORK) {
+            live++;  // The new task starts traced, with a SIGSTOP to swallow
+        } else if (signo != SIGSTOP && signo != SIGTRAP) {
+            inject = signo;
+        }
+        ptrace(PTRACE_SYSCALL, pid, NULL, (void *)(long)inject);
+    }
+
+    FILE *out = output ? fopen(output, "w") : stderr;
+    if (!out) {
+        perror(output);
+        return 1;
+    }
+    write_counts(out);
+    if (out != stderr) {
+        fclose(out);
+    }
+    return 0;
+}
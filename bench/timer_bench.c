@@ -0,0 +1,82 @@
+// Timer wheel microbenchmark: arming, re-arming, cancelling and advancing
+// with 1k to 1M connections' deadlines armed, which should all cost the same
+// Build and run with `make bench-timers`
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include "../src/metrics.h"
+#include "../src/timer_wheel.h"
+
+#define TICKS_PER_SECOND 10     // phase8's TIMER_TICK_MS is 100
+
+static long expired_count;
+
+static void count_expired(Timer *timer) {
+    (void)timer;
+    expired_count++;
+}
+
+static double per_op(uint64_t start, long operations) {
+    return (double)(metrics_now() - start) / operations;
+}
+
+// Deadlines phase8 uses: 5s idle, 10s header, 30s body, 300s request
+static uint64_t deadline(long i) {
+    static const int seconds[] = { 5, 10, 30, 300 };
+    return seconds[i & 3] * TICKS_PER_SECOND + (i % 7);
+}
+
+static void run(long connections) {
+    static TimerWheel wheel;
+    Timer *timers = calloc(connections, sizeof(Timer));
+    if (!timers) {
+        perror("calloc");
+        exit(1);
+    }
+    timer_wheel_init(&wheel, 0);
+
+    uint64_t start = metrics_now();
+    for (long i = 0; i < connections; i++) {
+        timer_wheel_add(&wheel, &timers[i], deadline(i));
+    }
+    double add = per_op(start, connections);
+
+    // Every connection moving to its next stage, as requests complete
+    start = metrics_now();
+    for (long i = 0; i < connections; i++) {
+        timer_wheel_add(&wheel, &timers[i], deadline(i + 1));
+    }
+    double rearm = per_op(start, connections);
+
+    // Ten minutes of ticks: everything expires, cascading through the levels
+    expired_count = 0;
+    long ticks = 600 * TICKS_PER_SECOND;
+    start = metrics_now();
+    timer_wheel_advance(&wheel, ticks, count_expired);
+    double advance = per_op(start, ticks + connections);
+
+    for (long i = 0; i < connections; i++) {
+        timer_wheel_add(&wheel, &timers[i], ticks + deadline(i));
+    }
+    start = metrics_now();
+    for (long i = 0; i < connections; i++) {
+        timer_wheel_cancel(&wheel, &timers[i]);
+    }
+    double cancel = per_op(start, connections);
+
+    printf("%8ld timers: add %6.1f ns  re-arm %6.1f ns  cancel %6.1f ns  advance %6.1f ns/(tick+expiry)  (%ld expired)\n",
+           connections, add, rearm, cancel, advance, expired_count);
+    free(timers);
+}
+
+int main(int argc, char *argv[]) {
+    long largest = argc > 1 ? atol(argv[1]) : 1000000;
+    if (largest < 1000) {
+        fprintf(stderr, "Usage: %s [max timers, at least 1000]\n", argv[0]);
+        return 1;
+    }
+    for (long connections = 1000; connections <= largest; connections *= 10) {
+        run(connections);
+    }
+    return 0;
+}
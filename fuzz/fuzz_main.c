@@ -0,0 +1,155 @@
+// Standalone driver for LLVMFuzzerTestOneInput, for compilers without
+// libFuzzer (build with -fsanitize=address,undefined, see `make fuzz`):
+//   fuzz_phase5 file...         run each file once (reproduce a crash)
+//   fuzz_phase5 < input         run stdin once (afl-fuzz -i seeds -o out -- ./fuzz_phase5)
+//   fuzz_phase5 -r runs [-s seed]
+//                               mutate the request corpus (bench/corpus.h) runs times
+// When a sanitizer reports an error the input is saved to crash-<seed>-<run>
+#define _POSIX_C_SOURCE 200809L
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../bench/corpus.h"
+
+#if defined(__SANITIZE_ADDRESS__)
+#include <sanitizer/common_interface_defs.h>
+#endif
+
+#define MAX_INPUT 8192
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+static uint8_t input[MAX_INPUT];
+static size_t input_size;
+static char crash_name[64];
+
+static void save_input(void) {
+    FILE *file = fopen(crash_name, "wb");
+    if (file) {
+        fwrite(input, 1, input_size, file);
+        fclose(file);
+        fprintf(stderr, "Input saved to %s\n", crash_name);
+    }
+}
+
+static int run_file(FILE *file) {
+    input_size = fread(input, 1, sizeof(input), file);
+    return LLVMFuzzerTestOneInput(input, input_size);
+}
+
+static uint64_t random_state;
+
+static uint64_t next_random(void) {
+    // xorshift64
+    uint64_t x = random_state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    random_state = x;
+    return x;
+}
+
+// Bytes that matter to the parsers
+static const char interesting[] = { ':', '\r', '\n', ' ', '\t', '%', '?', '&', '=', '+', '\0', '\xff' };
+
+static void mutate(void) {
+    int mutations = 1 + next_random() % 8;
+    for (int m = 0; m < mutations; m++) {
+        size_t pos = input_size ? next_random() % input_size : 0;
+        switch (next_random() % 6) {
+        case 0:  // Flip a bit
+            if (input_size) {
+                input[pos] ^= 1 << (next_random() % 8);
+            }
+            break;
+        case 1:  // Overwrite with an interesting byte
+            if (input_size) {
+                input[pos] = interesting[next_random() % sizeof(interesting)];
+            }
+            break;
+        case 2:  // Insert an interesting byte
+            if (input_size < MAX_INPUT) {
+                memmove(input + pos + 1, input + pos, input_size - pos);
+                input[pos] = interesting[next_random() % sizeof(interesting)];
+                input_size++;
+            }
+            break;
+        case 3: {  // Delete a run of bytes
+            size_t len = 1 + next_random() % 16;
+            if (pos + len > input_size) {
+                len = input_size - pos;
+            }
+            memmove(input + pos, input + pos + len, input_size - pos - len);
+            input_size -= len;
+            break;
+        }
+        case 4: {  // Duplicate a chunk (long lines, many headers and parameters)
+            size_t len = 1 + next_random() % 256;
+            if (pos + len > input_size) {
+                len = input_size - pos;
+            }
+            if (input_size + len <= MAX_INPUT) {
+                memmove(input + pos + len, input + pos, input_size - pos);
+                input_size += len;
+            }
+            break;
+        }
+        default:  // Truncate
+            input_size = pos;
+            break;
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    long runs = 0;
+    unsigned long seed = 1;
+    int opt;
+    while ((opt = getopt(argc, argv, "r:s:h")) != -1) {
+        switch (opt) {
+        case 'r':
+            runs = atol(optarg);
+            break;
+        case 's':
+            seed = strtoul(optarg, NULL, 10);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [file...] | -r runs [-s seed] | < input\n", argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+#if defined(__SANITIZE_ADDRESS__)
+    __sanitizer_set_death_callback(save_input);
+#endif
+
+    if (runs > 0) {
+        random_state = seed * 0x9e3779b97f4a7c15ULL + 1;
+        for (long run = 0; run < runs; run++) {
+            const char *request = samples[next_random() % SAMPLE_COUNT].request;
+            input_size = strlen(request);
+            memcpy(input, request, input_size);
+            mutate();
+            snprintf(crash_name, sizeof(crash_name), "crash-%lu-%ld", seed, run);
+            LLVMFuzzerTestOneInput(input, input_size);
+        }
+        printf("%ld runs, no sanitizer errors (seed %lu)\n", runs, seed);
+        return 0;
+    }
+
+    snprintf(crash_name, sizeof(crash_name), "crash-input");
+    if (optind == argc) {
+        return run_file(stdin);
+    }
+    for (int i = optind; i < argc; i++) {
+        FILE *file = fopen(argv[i], "rb");
+        if (!file) {
+            perror(argv[i]);
+            return 1;
+        }
+        run_file(file);
+        fclose(file);
+    }
+    return 0;
+}
@@ -0,0 +1,60 @@
+// Fuzz target for the phase5 parsing helpers (src/phase5_parsing.c)
+// libFuzzer: clang -fsanitize=fuzzer,address,undefined (make fuzz-libfuzzer)
+// AFL and plain gcc: link with fuzz_main.c instead (make fuzz)
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/phase5_parsing.h"
+
+#define BUFFER_SIZE 4096    // phase5 reads a request with one read() of this size
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+// Heap copy with exactly one terminating NUL, so the sanitizers catch a
+// read past the end of the input
+static char *copy_input(const uint8_t *data, size_t size) {
+    char *copy = malloc(size + 1);
+    if (copy) {
+        memcpy(copy, data, size);
+        copy[size] = '\0';
+    }
+    return copy;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    if (size > BUFFER_SIZE) {
+        size = BUFFER_SIZE;
+    }
+
+    // The request as phase5 handles it: headers, then the decoded target
+    char *request = copy_input(data, size);
+    if (!request) {
+        return 0;
+    }
+    static HttpRequest parsed;
+    parse_http_headers(request, &parsed);
+    char method[16];
+    char path[256];
+    char version[16];
+    if (sscanf(request, "%15s %255s %15s", method, path, version) == 3) {
+        static QueryString query;
+        url_decode(path);
+        parse_query_string(path, &query);
+    }
+    free(request);
+
+    // Each helper on its own, with input phase5's sscanf would never produce
+    char *target = copy_input(data, size);
+    if (target) {
+        url_decode(target);
+        free(target);
+    }
+    target = copy_input(data, size);
+    if (target) {
+        static QueryString query;
+        parse_query_string(target, &query);
+        free(target);
+    }
+    return 0;
+}
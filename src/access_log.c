@@ -0,0 +1,309 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "access_log.h"
+
+#define RING_RECORDS 2048           // Power of two
+#define WRITE_BATCH (64 * 1024)     // Bytes formatted before each write()
+#define MAX_LINE 4608               // Worst case for one formatted record (all bytes escaped)
+#define DRAIN_INTERVAL_NS (20 * 1000 * 1000)
+
+// Fixed-size copy of an AccessLogEntry; longer fields are truncated
+typedef struct {
+    time_t time;
+    int status;
+    long long bytes;
+    char client[46];
+    unsigned char method_len;
+    unsigned char protocol_len;
+    unsigned short target_len;
+    unsigned char referer_len;
+    unsigned char user_agent_len;
+    char method[16];
+    char protocol[16];
+    char target[256];
+    char referer[192];
+    char user_agent[192];
+} LogRecord;
+
+static int log_fd = -1;
+static AccessLogFormat log_format;
+
+// The event loop only advances head, the writer thread only advances tail
+static LogRecord ring[RING_RECORDS];
+static size_t ring_head;
+static size_t ring_tail;
+static unsigned long records_written;
+static unsigned long records_dropped;
+
+int access_log_parse_format(const char *name) {
+    if (strcmp(name, "common") == 0) {
+        return ACCESS_LOG_COMMON;
+    }
+    if (strcmp(name, "combined") == 0) {
+        return ACCESS_LOG_COMBINED;
+    }
+    if (strcmp(name, "json") == 0) {
+        return ACCESS_LOG_JSON;
+    }
+    return -1;
+}
+
+int access_log_open(const char *path, AccessLogFormat format) {
+    log_format = format;
+    if (strcmp(path, "-") == 0) {
+        log_fd = STDOUT_FILENO;
+        return 0;
+    }
+    log_fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    return log_fd < 0 ? -1 : 0;
+}
+
+int access_log_enabled(void) {
+    return log_fd >= 0;
+}
+
+unsigned long access_log_written(void) {
+    return records_written;
+}
+
+unsigned long access_log_dropped(void) {
+    return records_dropped;
+}
+
+static size_t copy_field(char *dst, size_t capacity, const char *src, size_t len) {
+    if (!src) {
+        return 0;
+    }
+    if (len > capacity) {
+        len = capacity;
+    }
+    memcpy(dst, src, len);
+    return len;
+}
+
+void access_log_write(const AccessLogEntry *entry) {
+    if (log_fd < 0) {
+        return;
+    }
+    size_t head = ring_head;
+    if (head - __atomic_load_n(&ring_tail, __ATOMIC_ACQUIRE) == RING_RECORDS) {
+        records_dropped++;  // Writer is behind - never wait for it
+        return;
+    }
+
+    LogRecord *record = &ring[head & (RING_RECORDS - 1)];
+    record->time = entry->time;
+    record->status = entry->status;
+    record->bytes = entry->bytes;
+    snprintf(record->client, sizeof(record->client), "%s", entry->client ? entry->client : "-");
+    record->method_len = copy_field(record->method, sizeof(record->method), entry->method, entry->method_len);
+    record->protocol_len = copy_field(record->protocol, sizeof(record->protocol), entry->protocol, entry->protocol_len);
+    record->target_len = copy_field(record->target, sizeof(record->target), entry->target, entry->target_len);
+    record->referer_len = copy_field(record->referer, sizeof(record->referer), entry->referer, entry->referer_len);
+    record->user_agent_len = copy_field(record->user_agent, sizeof(record->user_agent),
+                                        entry->user_agent, entry->user_agent_len);
+
+    __atomic_store_n(&ring_head, head + 1, __ATOMIC_RELEASE);
+    records_written++;
+}
+
+// ---------------------------------------------------------------------------
+// Writer thread
+
+// Append a field, escaping quotes, backslashes and non-printable bytes;
+// an empty field is written as "-"
+static char *append_escaped(char *out, const char *field, size_t len, int json) {
+    static const char hex[] = "0123456789abcdef";
+    if (len == 0 && !json) {
+        *out++ = '-';
+        return out;
+    }
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = field[i];
+        if (c == '"' || c == '\\') {
+            *out++ = '\\';
+            *out++ = c;
+        } else if (c < 0x20 || c >= 0x7f) {
+            if (json) {
+                memcpy(out, "\\u00", 4);
+                out += 4;
+            } else {
+                *out++ = '\\';
+                *out++ = 'x';
+            }
+            *out++ = hex[c >> 4];
+            *out++ = hex[c & 0xf];
+        } else {
+            *out++ = c;
+        }
+    }
+    return out;
+}
+
+static char *append_string(char *out, const char *str) {
+    size_t len = strlen(str);
+    memcpy(out, str, len);
+    return out + len;
+}
+
+// Time strings change once a second, so they are rendered once per second
+typedef struct {
+    time_t second;
+    char clf[40];               // 10/Oct/2000:13:55:36 -0700
+    char iso[40];               // 2000-10-10T13:55:36-0700
+} LogTime;
+
+static void update_log_time(LogTime *log_time, time_t second) {
+    if (log_time->second == second) {
+        return;
+    }
+    struct tm tm;
+    localtime_r(&second, &tm);
+    strftime(log_time->clf, sizeof(log_time->clf), "%d/%b/%Y:%H:%M:%S %z", &tm);
+    strftime(log_time->iso, sizeof(log_time->iso), "%Y-%m-%dT%H:%M:%S%z", &tm);
+    log_time->second = second;
+}
+
+static size_t format_record(const LogRecord *record, LogTime *log_time, char *line) {
+    char *out = line;
+    char number[32];
+    update_log_time(log_time, record->time);
+
+    if (log_format == ACCESS_LOG_JSON) {
+        out = append_string(out, "{\"time\":\"");
+        out = append_string(out, log_time->iso);
+        out = append_string(out, "\",\"remote_addr\":\"");
+        out = append_string(out, record->client);
+        out = append_string(out, "\",\"method\":\"");
+        out = append_escaped(out, record->method, record->method_len, 1);
+        out = append_string(out, "\",\"target\":\"");
+        out = append_escaped(out, record->target, record->target_len, 1);
+        out = append_string(out, "\",\"protocol\":\"");
+        out = append_escaped(out, record->protocol, record->protocol_len, 1);
+        snprintf(number, sizeof(number), "\",\"status\":%d", record->status);
+        out = append_string(out, number);
+        snprintf(number, sizeof(number), ",\"bytes\":%lld", record->bytes);
+        out = append_string(out, number);
+        out = append_string(out, ",\"referer\":\"");
+        out = append_escaped(out, record->referer, record->referer_len, 1);
+        out = append_string(out, "\",\"user_agent\":\"");
+        out = append_escaped(out, record->user_agent, record->user_agent_len, 1);
+        out = append_string(out, "\"}\n");
+        return out - line;
+    }
+
+    // host ident authuser [date] "request" status bytes
+    out = append_string(out, record->client);
+    out = append_string(out, " - - [");
+    out = append_string(out, log_time->clf);
+    out = append_string(out, "] \"");
+    if (record->method_len) {
+        out = append_escaped(out, record->method, record->method_len, 0);
+        *out++ = ' ';
+        out = append_escaped(out, record->target, record->target_len, 0);
+        *out++ = ' ';
+        out = append_escaped(out, record->protocol, record->protocol_len, 0);
+    } else {
+        *out++ = '-';  // No parsable request line
+    }
+    snprintf(number, sizeof(number), "\" %d ", record->status);
+    out = append_string(out, number);
+    if (record->bytes > 0) {
+        snprintf(number, sizeof(number), "%lld", record->bytes);
+        out = append_string(out, number);
+    } else {
+        *out++ = '-';
+    }
+    if (log_format == ACCESS_LOG_COMBINED) {
+        out = append_string(out, " \"");
+        out = append_escaped(out, record->referer, record->referer_len, 0);
+        out = append_string(out, "\" \"");
+        out = append_escaped(out, record->user_agent, record->user_agent_len, 0);
+        *out++ = '"';
+    }
+    *out++ = '\n';
+    return out - line;
+}
+
+static void write_batch(const char *batch, size_t len) {
+    while (len > 0) {
+        ssize_t written = write(log_fd, batch, len);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return;  // Nowhere to report it - the batch is lost
+        }
+        batch += written;
+        len -= written;
+    }
+}
+
+// Drain the ring into one large buffer and write it when it fills up or
+// the ring runs dry; sleep briefly when there is nothing to do
+static void *writer_main(void *arg) {
+    (void)arg;
+    static char batch[WRITE_BATCH];
+    size_t used = 0;
+    LogTime log_time = { -1, "", "" };
+    struct timespec interval = { 0, DRAIN_INTERVAL_NS };
+
+    while (1) {
+        size_t tail = ring_tail;
+        size_t head = __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE);
+        if (tail == head) {
+            if (used > 0) {
+                write_batch(batch, used);
+                used = 0;
+            }
+            nanosleep(&interval, NULL);
+            continue;
+        }
+        for (; tail != head; tail++) {
+            if (used + MAX_LINE > sizeof(batch)) {
+                write_batch(batch, used);
+                used = 0;
+            }
+            used += format_record(&ring[tail & (RING_RECORDS - 1)], &log_time, batch + used);
+            __atomic_store_n(&ring_tail, tail + 1, __ATOMIC_RELEASE);
+        }
+    }
+    return NULL;
+}
+
+int access_log_start(void) {
+    if (log_fd < 0) {
+        return 0;
+    }
+    ring_head = 0;
+    ring_tail = 0;
+    records_written = 0;
+    records_dropped = 0;
+
+    // Signals stay with the event loop thread, whose epoll_wait() they interrupt
+    sigset_t all_signals;
+    sigset_t previous;
+    sigfillset(&all_signals);
+    pthread_sigmask(SIG_SETMASK, &all_signals, &previous);
+
+    pthread_t thread;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int result = pthread_create(&thread, &attr, writer_main, NULL);
+    pthread_attr_destroy(&attr);
+
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    if (result != 0) {
+        errno = result;
+        return -1;
+    }
+    return 0;
+}
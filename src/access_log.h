@@ -0,0 +1,61 @@
+#ifndef ACCESS_LOG_H
+#define ACCESS_LOG_H
+
+#include <stddef.h>
+#include <time.h>
+
+// Asynchronous access log
+//
+// The event loop copies each finished request into a single-producer,
+// single-consumer ring buffer and never blocks: when the ring is full the
+// record is dropped and counted. A writer thread formats the records and
+// writes them to the log file in large batches. Each worker process has its
+// own ring and writer thread (threads do not survive fork()), so
+// access_log_start() runs in the process that serves requests.
+
+typedef enum {
+    ACCESS_LOG_COMMON,          // Common Log Format
+    ACCESS_LOG_COMBINED,        // Common + "Referer" "User-Agent"
+    ACCESS_LOG_JSON             // One JSON object per line
+} AccessLogFormat;
+
+// One request, as (pointer, length) pairs that only need to stay valid for
+// the access_log_write() call; NULL fields are logged as "-"
+typedef struct {
+    time_t time;
+    const char *client;
+    const char *method;
+    size_t method_len;
+    const char *target;
+    size_t target_len;
+    const char *protocol;
+    size_t protocol_len;
+    const char *referer;
+    size_t referer_len;
+    const char *user_agent;
+    size_t user_agent_len;
+    int status;
+    long long bytes;            // Response body bytes
+} AccessLogEntry;
+
+// Parse "common", "combined" or "json"; returns -1 for anything else
+int access_log_parse_format(const char *name);
+
+// Open the log ("-" for stdout) before forking workers
+// Returns -1 with errno set if the file can't be opened
+int access_log_open(const char *path, AccessLogFormat format);
+
+// Start the writer thread for this process; returns -1 on failure
+int access_log_start(void);
+
+// Queue a record; never blocks (drops it if the ring is full)
+void access_log_write(const AccessLogEntry *entry);
+
+// Is logging enabled (so callers can skip building entries)?
+int access_log_enabled(void);
+
+// Records queued and dropped by this process so far
+unsigned long access_log_written(void);
+unsigned long access_log_dropped(void);
+
+#endif
@@ -0,0 +1,166 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "asset_pack.h"
+
+uint64_t asset_pack_hash(const char *path) {
+    uint64_t hash = 14695981039346656037ULL;
+    while (*path) {
+        hash ^= (unsigned char)*path++;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static int blob_valid(const AssetPack *pack, AssetBlob blob, size_t max_length) {
+    return blob.offset <= pack->size && blob.length <= pack->size - blob.offset && blob.length <= max_length;
+}
+
+// A NUL terminated string: the NUL must be in the pack too
+static int string_valid(const AssetPack *pack, AssetBlob blob, size_t max_length) {
+    return blob_valid(pack, blob, max_length) && blob.length < pack->size - blob.offset &&
+           pack->base[blob.offset + blob.length] == '\0';
+}
+
+static int record_valid(const AssetPack *pack, const AssetRecord *record) {
+    if (!string_valid(pack, record->path, ASSET_PACK_MAX_PATH - 1) ||
+        !string_valid(pack, record->content_type, 255) ||
+        !blob_valid(pack, record->header, ASSET_PACK_MAX_HEADER) ||
+        !blob_valid(pack, record->body, SIZE_MAX) ||
+        !memchr(record->etag, '\0', sizeof(record->etag)) ||
+        !memchr(record->last_modified, '\0', sizeof(record->last_modified))) {
+        return 0;
+    }
+    for (int i = 0; i < ASSET_ENCODINGS; i++) {
+        const AssetVariant *variant = &record->variants[i];
+        if (!blob_valid(pack, variant->body, SIZE_MAX) ||
+            !blob_valid(pack, variant->header, ASSET_PACK_MAX_HEADER) ||
+            !memchr(variant->etag, '\0', sizeof(variant->etag))) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int pack_valid(const AssetPack *pack) {
+    if (pack->size < sizeof(AssetPackHeader)) {
+        return 0;
+    }
+    const AssetPackHeader *header = (const AssetPackHeader *)pack->base;
+    if (memcmp(header->magic, ASSET_PACK_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != ASSET_PACK_VERSION || header->size != pack->size) {
+        return 0;
+    }
+    // Room for every record and bucket, an empty bucket to end each probe
+    uint32_t buckets = header->bucket_count;
+    if (buckets == 0 || (buckets & (buckets - 1)) != 0 || buckets <= header->asset_count ||
+        header->records_offset % 8 != 0 || header->buckets_offset % 4 != 0 ||
+        header->records_offset > pack->size ||
+        (pack->size - header->records_offset) / sizeof(AssetRecord) < header->asset_count ||
+        header->buckets_offset > pack->size ||
+        (pack->size - header->buckets_offset) / sizeof(uint32_t) < buckets) {
+        return 0;
+    }
+    const AssetRecord *records = (const AssetRecord *)(pack->base + header->records_offset);
+    for (uint32_t i = 0; i < header->asset_count; i++) {
+        if (!record_valid(pack, &records[i])) {
+            return 0;
+        }
+    }
+    const uint32_t *index = (const uint32_t *)(pack->base + header->buckets_offset);
+    for (uint32_t i = 0; i < buckets; i++) {
+        if (index[i] > header->asset_count) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int asset_pack_open(AssetPack *pack, const char *file_name) {
+    memset(pack, 0, sizeof(*pack));
+    pack->fd = open(file_name, O_RDONLY | O_CLOEXEC);
+    if (pack->fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(pack->fd, &st) < 0) {
+        asset_pack_close(pack);
+        return -1;
+    }
+    if (st.st_size < (off_t)sizeof(AssetPackHeader)) {
+        asset_pack_close(pack);
+        errno = EINVAL;
+        return -1;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, pack->fd, 0);
+    if (map == MAP_FAILED) {
+        asset_pack_close(pack);
+        return -1;
+    }
+    pack->base = map;
+    pack->size = st.st_size;
+    if (!pack_valid(pack)) {
+        asset_pack_close(pack);
+        errno = EINVAL;
+        return -1;
+    }
+    const AssetPackHeader *header = (const AssetPackHeader *)pack->base;
+    pack->records = (const AssetRecord *)(pack->base + header->records_offset);
+    pack->buckets = (const uint32_t *)(pack->base + header->buckets_offset);
+    pack->asset_count = header->asset_count;
+    pack->bucket_mask = header->bucket_count - 1;
+    return 0;
+}
+
+void asset_pack_close(AssetPack *pack) {
+    if (pack->base) {
+        munmap((void *)pack->base, pack->size);
+    }
+    if (pack->fd >= 0) {
+        close(pack->fd);
+    }
+    memset(pack, 0, sizeof(*pack));
+    pack->fd = -1;
+}
+
+const AssetRecord *asset_pack_find(const AssetPack *pack, const char *path) {
+    uint64_t hash = asset_pack_hash(path);
+    for (uint32_t slot = hash & pack->bucket_mask; pack->buckets[slot] != 0;
+         slot = (slot + 1) & pack->bucket_mask) {
+        const AssetRecord *record = &pack->records[pack->buckets[slot] - 1];
+        if (record->hash == hash && strcmp(asset_pack_bytes(pack, record->path), path) == 0) {
+            return record;
+        }
+    }
+    return NULL;
+}
+
+int asset_format_header(char *buf, size_t size, const char *content_type, const char *encoding,
+                        long long length, const char *last_modified, const char *etag, int vary,
+                        const char *cache_control) {
+    int len = snprintf(buf, size,
+        "Server: MyHTTPServer/1.0\r\n"
+        "Content-Type: %s\r\n"
+        "%s%s%s"
+        "Content-Length: %lld\r\n"
+        "%s"
+        "%s"
+        "Last-Modified: %s\r\n"
+        "ETag: %s\r\n"
+        "%s%s%s"
+        "\r\n", content_type,
+        encoding ? "Content-Encoding: " : "", encoding ? encoding : "", encoding ? "\r\n" : "",
+        length, encoding ? "" : "Accept-Ranges: bytes\r\n",
+        vary || encoding ? "Vary: Accept-Encoding\r\n" : "", last_modified, etag,
+        cache_control ? "Cache-Control: " : "", cache_control ? cache_control : "", cache_control ? "\r\n" : "");
+    return len >= 0 && (size_t)len < size ? len : -1;
+}
+
+void asset_format_variant_etag(char *buf, size_t size, const char *etag, const char *encoding) {
+    snprintf(buf, size, "%.*s-%s\"", (int)strlen(etag) - 1, etag, encoding);
+}
@@ -0,0 +1,104 @@
+#ifndef ASSET_PACK_H
+#define ASSET_PACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Asset pack: the files of one or more directories in a single file, built
+// ahead of time by tools/pack_gen (make pack) and memory-mapped by phase8 -P
+//
+// Layout: a header, a table of fixed-size asset records, a hash index over
+// the paths, then the bytes the records point at (paths, header blocks,
+// bodies, compressed variants). Paths are stored the way the server builds
+// them ("./public/index.html"); the index is open addressing with linear
+// probing, holding record number + 1 (0 = empty slot). All integers are
+// in host byte order - a pack is built on the machine, or at least the
+// architecture, that serves it. Nothing is copied or parsed at startup
+// beyond a bounds check of every record, so opening a pack of tens of
+// thousands of assets takes a few milliseconds.
+
+#define ASSET_PACK_MAGIC "HTTPPACK"
+#define ASSET_PACK_VERSION 1
+#define ASSET_PACK_MAX_PATH 512     // Including the terminating NUL
+#define ASSET_PACK_MAX_HEADER 512
+
+// Content-codings of the compressed variants, in preference order
+enum { ASSET_BR, ASSET_GZIP, ASSET_ENCODINGS };
+
+// Bytes [offset, offset + length) of the pack
+typedef struct {
+    uint64_t offset;
+    uint64_t length;
+} AssetBlob;
+
+typedef struct {
+    AssetBlob body;             // length 0 = no such variant
+    AssetBlob header;
+    char etag[64];
+} AssetVariant;
+
+typedef struct {
+    uint64_t hash;              // asset_pack_hash() of the path
+    AssetBlob path;             // NUL terminated (length excludes the NUL)
+    AssetBlob content_type;     // NUL terminated
+    AssetBlob header;           // Header block without Cache-Control (see asset_format_header)
+    AssetBlob body;
+    int64_t mtime;
+    uint32_t compressible;      // Responses carry Vary: Accept-Encoding
+    uint32_t reserved;
+    char etag[48];              // Strong validator from size and content hash
+    char last_modified[32];
+    AssetVariant variants[ASSET_ENCODINGS];
+} AssetRecord;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t asset_count;
+    uint32_t bucket_count;      // Power of two
+    uint32_t reserved;
+    uint64_t records_offset;    // AssetRecord[asset_count]
+    uint64_t buckets_offset;    // uint32_t[bucket_count]
+    uint64_t size;              // Of the whole pack
+} AssetPackHeader;
+
+// A mapped pack
+typedef struct {
+    int fd;                     // Kept open: large bodies are sent from it with sendfile()
+    const char *base;
+    size_t size;
+    const AssetRecord *records;
+    const uint32_t *buckets;
+    uint32_t asset_count;
+    uint32_t bucket_mask;
+} AssetPack;
+
+// FNV-1a of a path
+uint64_t asset_pack_hash(const char *path);
+
+// Map a pack and check that everything in it is in bounds; returns -1
+// with errno set (EINVAL for a file that is not a valid pack)
+int asset_pack_open(AssetPack *pack, const char *file_name);
+void asset_pack_close(AssetPack *pack);
+
+// Record of a path, or NULL if the pack does not hold it
+const AssetRecord *asset_pack_find(const AssetPack *pack, const char *path);
+
+static inline const char *asset_pack_bytes(const AssetPack *pack, AssetBlob blob) {
+    return pack->base + blob.offset;
+}
+
+// Header block of a file response: everything after the status line, Date
+// and Connection, up to and including the blank line. encoding is NULL for
+// the identity body, which also advertises Accept-Ranges; vary adds
+// Vary: Accept-Encoding (always there with an encoding). The file cache
+// formats its entries with this too, so packed and loose files get the
+// same headers. Returns the length, or -1 if it does not fit in size
+int asset_format_header(char *buf, size_t size, const char *content_type, const char *encoding,
+                        long long length, const char *last_modified, const char *etag, int vary,
+                        const char *cache_control);
+
+// ETag of a compressed variant: the file's with the coding appended
+void asset_format_variant_etag(char *buf, size_t size, const char *etag, const char *encoding);
+
+#endif
@@ -0,0 +1,190 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <zlib.h>
+#include "compress.h"
+
+#define COMPRESS_QUEUE 64           // Jobs queued or finished but not yet collected
+#define GZIP_LEVEL 6
+#define GZIP_WINDOW_BITS (15 + 16)  // 32KB window, gzip wrapper
+
+typedef enum {
+    JOB_FREE,
+    JOB_PENDING,
+    JOB_RUNNING,
+    JOB_DONE
+} JobState;
+
+typedef struct {
+    JobState state;
+    void *owner;
+    int fd;
+    size_t size;
+    char *data;                 // Result (JOB_DONE)
+    size_t len;
+} CompressJob;
+
+static CompressJob jobs[COMPRESS_QUEUE];
+static pthread_mutex_t jobs_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t jobs_ready = PTHREAD_COND_INITIALIZER;
+static int done_fd = -1;
+
+int gzip_compress(const char *data, size_t len, char **out, size_t *out_len) {
+    z_stream stream = { 0 };
+    if (deflateInit2(&stream, GZIP_LEVEL, Z_DEFLATED, GZIP_WINDOW_BITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return -1;
+    }
+    size_t capacity = deflateBound(&stream, len);
+    char *buffer = malloc(capacity);
+    if (!buffer) {
+        deflateEnd(&stream);
+        return -1;
+    }
+    stream.next_in = (Bytef *)data;
+    stream.avail_in = len;
+    stream.next_out = (Bytef *)buffer;
+    stream.avail_out = capacity;
+    int result = deflate(&stream, Z_FINISH);
+    size_t compressed = stream.total_out;
+    deflateEnd(&stream);
+    if (result != Z_STREAM_END || compressed >= len) {
+        free(buffer);
+        return -1;
+    }
+    *out = buffer;
+    *out_len = compressed;
+    return 0;
+}
+
+// Read a whole file with pread() (the fd's offset is shared with sendfile() users)
+static char *read_file(int fd, size_t size) {
+    char *buffer = malloc(size);
+    size_t done = 0;
+    while (buffer && done < size) {
+        ssize_t got = pread(fd, buffer + done, size - done, done);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            free(buffer);
+            return NULL;
+        }
+        done += got;
+    }
+    return buffer;
+}
+
+static void *compressor_main(void *arg) {
+    (void)arg;
+    while (1) {
+        pthread_mutex_lock(&jobs_lock);
+        CompressJob *job = NULL;
+        while (!job) {
+            for (int i = 0; i < COMPRESS_QUEUE && !job; i++) {
+                if (jobs[i].state == JOB_PENDING) {
+                    job = &jobs[i];
+                }
+            }
+            if (!job) {
+                pthread_cond_wait(&jobs_ready, &jobs_lock);
+            }
+        }
+        job->state = JOB_RUNNING;
+        int fd = job->fd;
+        size_t size = job->size;
+        pthread_mutex_unlock(&jobs_lock);
+
+        char *compressed = NULL;
+        size_t len = 0;
+        char *contents = read_file(fd, size);
+        if (contents && gzip_compress(contents, size, &compressed, &len) < 0) {
+            compressed = NULL;
+            len = 0;
+        }
+        free(contents);
+
+        pthread_mutex_lock(&jobs_lock);
+        job->data = compressed;
+        job->len = len;
+        job->state = JOB_DONE;
+        pthread_mutex_unlock(&jobs_lock);
+        uint64_t one = 1;
+        while (write(done_fd, &one, sizeof(one)) < 0 && errno == EINTR) {
+        }
+    }
+    return NULL;
+}
+
+int compress_start(void) {
+    done_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (done_fd < 0) {
+        return -1;
+    }
+
+    // Signals stay with the event loop thread, whose epoll_wait() they interrupt
+    sigset_t all_signals;
+    sigset_t previous;
+    sigfillset(&all_signals);
+    pthread_sigmask(SIG_SETMASK, &all_signals, &previous);
+
+    pthread_t thread;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int result = pthread_create(&thread, &attr, compressor_main, NULL);
+    pthread_attr_destroy(&attr);
+
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    if (result != 0) {
+        close(done_fd);
+        done_fd = -1;
+        errno = result;
+        return -1;
+    }
+    return done_fd;
+}
+
+int compress_submit(void *owner, int fd, size_t size) {
+    if (done_fd < 0) {
+        return -1;
+    }
+    int submitted = -1;
+    pthread_mutex_lock(&jobs_lock);
+    for (int i = 0; i < COMPRESS_QUEUE; i++) {
+        if (jobs[i].state == JOB_FREE) {
+            jobs[i].state = JOB_PENDING;
+            jobs[i].owner = owner;
+            jobs[i].fd = fd;
+            jobs[i].size = size;
+            submitted = 0;
+            pthread_cond_signal(&jobs_ready);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&jobs_lock);
+    return submitted;
+}
+
+void compress_collect(CompressDone done) {
+    uint64_t count;
+    while (read(done_fd, &count, sizeof(count)) < 0 && errno == EINTR) {
+    }
+    for (int i = 0; i < COMPRESS_QUEUE; i++) {
+        pthread_mutex_lock(&jobs_lock);
+        if (jobs[i].state != JOB_DONE) {
+            pthread_mutex_unlock(&jobs_lock);
+            continue;
+        }
+        void *owner = jobs[i].owner;
+        char *data = jobs[i].data;
+        size_t len = jobs[i].len;
+        jobs[i].state = JOB_FREE;
+        pthread_mutex_unlock(&jobs_lock);
+        done(owner, data, len);
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include <stddef.h>
+
+#define COMPRESS_MIN_SIZE 256     // Smaller files are not worth a Content-Encoding
+
+// gzip compression for responses compressed on the fly
+//
+// Small files are compressed on the event loop with gzip_compress(). Larger
+// ones go to a compressor thread: the event loop submits a job (an open fd,
+// the file size and an opaque owner pointer) and carries on serving the
+// uncompressed file. The thread reads and compresses the file, queues the
+// result and signals an eventfd that the event loop polls; compress_collect()
+// then hands each finished job back on the event loop thread. Like the
+// access log writer, each worker process starts its own thread after fork().
+
+// Compress len bytes into a gzip member in a malloc'd buffer
+// Returns -1 on failure or if the output would not be smaller
+int gzip_compress(const char *data, size_t len, char **out, size_t *out_len);
+
+// Start the compressor thread; returns the eventfd to poll for completed jobs, or -1
+int compress_start(void);
+
+// Queue the compression of size bytes read from fd (which must stay open
+// until the job is collected); returns -1 if the queue is full
+int compress_submit(void *owner, int fd, size_t size);
+
+// Called for each finished job; data is NULL (len 0) if it failed or did
+// not shrink the file, else a malloc'd buffer the callee now owns
+typedef void (*CompressDone)(void *owner, char *data, size_t len);
+
+// Drain the eventfd and report every finished job
+void compress_collect(CompressDone done);
+
+#endif
@@ -0,0 +1,466 @@
+#include <limits.h>
+#include <string.h>
+#include <strings.h>
+#include "http_parser.h"
+#include "http_scan.h"
+
+enum {
+    STAGE_REQUEST_LINE,
+    STAGE_HEADERS,
+    STAGE_DONE
+};
+
+static HttpSlice make_slice(size_t start, size_t end) {
+    HttpSlice slice = { (uint32_t)start, (uint32_t)(end - start) };
+    return slice;
+}
+
+static HttpParseResult fail(HttpParser *parser, int status) {
+    parser->error_status = status;
+    return HTTP_PARSE_ERROR;
+}
+
+// METHOD SP request-target SP HTTP/x.y
+// Control characters were already rejected while finding the line end
+static HttpParseResult parse_request_line(HttpParser *parser, const char *data, size_t start, size_t end) {
+    size_t method_end = http_scan_token(data, start, end);
+    if (method_end == start || method_end == end || data[method_end] != ' ') {
+        return fail(parser, 400);
+    }
+
+    // A space inside the target leaves a version that fails the check below
+    size_t target_start = method_end + 1;
+    const char *space = memchr(data + target_start, ' ', end - target_start);
+    if (!space) {
+        return fail(parser, 400);
+    }
+    size_t target_end = space - data;
+    if (target_start == target_end) {
+        return fail(parser, 400);
+    }
+
+    size_t version_start = target_end + 1;
+    if (end - version_start != 8 || memcmp(data + version_start, "HTTP/", 5) != 0 ||
+        data[version_start + 5] < '0' || data[version_start + 5] > '9' ||
+        data[version_start + 6] != '.' ||
+        data[version_start + 7] < '0' || data[version_start + 7] > '9') {
+        return fail(parser, 400);
+    }
+
+    parser->method = make_slice(start, method_end);
+    parser->target = make_slice(target_start, target_end);
+    parser->version = make_slice(version_start, end);
+    return HTTP_PARSE_INCOMPLETE;
+}
+
+// field-name ":" OWS field-value OWS
+static HttpParseResult parse_header_line(HttpParser *parser, const char *data, size_t start, size_t end,
+                                         const HttpParserLimits *limits) {
+    // Also rejects obsolete line folding and whitespace before the colon
+    size_t name_end = http_scan_token(data, start, end);
+    if (name_end == start || name_end == end || data[name_end] != ':') {
+        return fail(parser, 400);
+    }
+    if (parser->header_count >= limits->max_headers || parser->header_count >= HTTP_MAX_HEADERS) {
+        return fail(parser, 431);
+    }
+
+    size_t value_start = name_end + 1;
+    while (value_start < end && (data[value_start] == ' ' || data[value_start] == '\t')) {
+        value_start++;
+    }
+    size_t value_end = end;
+    while (value_end > value_start && (data[value_end - 1] == ' ' || data[value_end - 1] == '\t')) {
+        value_end--;
+    }
+
+    HttpHeaderField *field = &parser->headers[parser->header_count++];
+    field->name = make_slice(start, name_end);
+    field->value = make_slice(value_start, value_end);
+
+    // Chunked bodies are not supported, so a request with Transfer-Encoding
+    // can't be framed; with Content-Length as well it is a smuggling attempt
+    if (http_slice_equals_nocase(data, field->name, "Transfer-Encoding")) {
+        return fail(parser, parser->content_length >= 0 ? 400 : 501);
+    }
+
+    // Content-Length frames the body, so it is validated here
+    if (http_slice_equals_nocase(data, field->name, "Content-Length")) {
+        long long length = 0;
+        if (value_start == value_end) {
+            return fail(parser, 400);
+        }
+        for (size_t i = value_start; i < value_end; i++) {
+            if (data[i] < '0' || data[i] > '9' || length > (0x7fffffffffffffffLL - 9) / 10) {
+                return fail(parser, 400);
+            }
+            length = length * 10 + (data[i] - '0');
+        }
+        if (parser->content_length >= 0 && parser->content_length != length) {
+            return fail(parser, 400);  // Conflicting lengths
+        }
+        parser->content_length = length;
+        if (length > limits->max_body) {
+            return fail(parser, 413);
+        }
+    }
+    return HTTP_PARSE_INCOMPLETE;
+}
+
+void http_parser_init(HttpParser *parser) {
+    parser->stage = STAGE_REQUEST_LINE;
+    parser->line_start = 0;
+    parser->scan_pos = 0;
+    parser->header_count = 0;
+    parser->head_length = 0;
+    parser->content_length = -1;
+    parser->error_status = 0;
+    parser->method = (HttpSlice){ 0, 0 };
+    parser->target = (HttpSlice){ 0, 0 };
+    parser->version = (HttpSlice){ 0, 0 };
+}
+
+HttpParseResult http_parser_execute(HttpParser *parser, const char *data, size_t len,
+                                    const HttpParserLimits *limits) {
+    if (parser->stage == STAGE_DONE) {
+        return HTTP_PARSE_DONE;
+    }
+    if (parser->error_status) {
+        return HTTP_PARSE_ERROR;
+    }
+
+    while (parser->scan_pos < len) {
+        // One pass finds the line end and rejects control characters in the line
+        size_t stop = http_scan_ctl(data, parser->scan_pos, len);
+        if (stop == len) {
+            parser->scan_pos = len;
+            break;
+        }
+        size_t next_line;
+        if (data[stop] == '\n') {
+            next_line = stop + 1;  // Bare LF is tolerated
+        } else if (data[stop] == '\r' && stop + 1 == len) {
+            parser->scan_pos = stop;  // Wait for the LF
+            break;
+        } else if (data[stop] == '\r' && data[stop + 1] == '\n') {
+            next_line = stop + 2;
+        } else {
+            return fail(parser, 400);  // Control character or bare CR
+        }
+        size_t line_start = parser->line_start;
+        size_t line_end = stop;
+        parser->line_start = next_line;
+        parser->scan_pos = next_line;
+
+        if (parser->stage == STAGE_REQUEST_LINE) {
+            if (line_end == line_start) {
+                continue;  // Empty lines before the request line are ignored
+            }
+            if (line_end - line_start > limits->max_request_line) {
+                return fail(parser, 414);
+            }
+            if (parse_request_line(parser, data, line_start, line_end) == HTTP_PARSE_ERROR) {
+                return HTTP_PARSE_ERROR;
+            }
+            parser->stage = STAGE_HEADERS;
+        } else {
+            if (next_line > limits->max_header_bytes) {
+                return fail(parser, 431);
+            }
+            if (line_end == line_start) {
+                parser->stage = STAGE_DONE;
+                parser->head_length = next_line;
+                return HTTP_PARSE_DONE;
+            }
+            if (parse_header_line(parser, data, line_start, line_end, limits) == HTTP_PARSE_ERROR) {
+                return HTTP_PARSE_ERROR;
+            }
+        }
+    }
+
+    // Partial line: enforce limits now rather than waiting for the end of it
+    if (parser->stage == STAGE_REQUEST_LINE && len - parser->line_start > limits->max_request_line) {
+        return fail(parser, 414);
+    }
+    // With max_header_bytes buffered and no blank line yet the head must be longer
+    if (len >= limits->max_header_bytes) {
+        return fail(parser, parser->stage == STAGE_REQUEST_LINE ? 414 : 431);
+    }
+    return HTTP_PARSE_INCOMPLETE;
+}
+
+int http_slice_equals(const char *data, HttpSlice slice, const char *str) {
+    return strlen(str) == slice.length && memcmp(data + slice.offset, str, slice.length) == 0;
+}
+
+int http_slice_equals_nocase(const char *data, HttpSlice slice, const char *str) {
+    return strlen(str) == slice.length && strncasecmp(data + slice.offset, str, slice.length) == 0;
+}
+
+const HttpHeaderField *http_parser_header(const HttpParser *parser, const char *data, const char *name) {
+    for (int i = 0; i < parser->header_count; i++) {
+        if (http_slice_equals_nocase(data, parser->headers[i].name, name)) {
+            return &parser->headers[i];
+        }
+    }
+    return NULL;
+}
+
+// Digits of a range bound; returns the position after them, or NULL if
+// there are none or the value would overflow
+static const char *parse_range_number(const char *p, const char *end, long long *value) {
+    const char *start = p;
+    long long number = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        if (number > (LLONG_MAX - 9) / 10) {
+            return NULL;
+        }
+        number = number * 10 + (*p - '0');
+        p++;
+    }
+    *value = number;
+    return p > start ? p : NULL;
+}
+
+static const char *skip_ows(const char *p, const char *end) {
+    while (p < end && (*p == ' ' || *p == '\t')) {
+        p++;
+    }
+    return p;
+}
+
+int http_parse_range(const char *value, size_t len, long long size, HttpRange *ranges, int max_ranges) {
+    const char *p = value;
+    const char *end = value + len;
+    if (len < 6 || strncasecmp(p, "bytes=", 6) != 0) {
+        return HTTP_RANGE_IGNORE;
+    }
+    p += 6;
+
+    int count = 0;
+    int specs = 0;
+    while (1) {
+        p = skip_ows(p, end);
+        if (p < end && *p == ',') {
+            p++;  // Empty list elements are allowed
+            continue;
+        }
+        if (p == end) {
+            break;
+        }
+        if (++specs > max_ranges) {
+            return HTTP_RANGE_IGNORE;  // Too many to be a real client - not worth the work
+        }
+
+        long long first = 0;
+        long long last = size - 1;
+        int satisfiable = 1;
+        if (*p == '-') {
+            // Suffix: the last n bytes
+            long long suffix;
+            if ((p = parse_range_number(p + 1, end, &suffix)) == NULL) {
+                return HTTP_RANGE_IGNORE;
+            }
+            if (suffix == 0 || size == 0) {
+                satisfiable = 0;
+            } else {
+                first = suffix >= size ? 0 : size - suffix;
+            }
+        } else {
+            if ((p = parse_range_number(p, end, &first)) == NULL || p == end || *p != '-') {
+                return HTTP_RANGE_IGNORE;
+            }
+            p++;
+            if (p < end && *p >= '0' && *p <= '9') {
+                if ((p = parse_range_number(p, end, &last)) == NULL) {
+                    return HTTP_RANGE_IGNORE;
+                }
+                if (last < first) {
+                    return HTTP_RANGE_IGNORE;
+                }
+                if (last >= size) {
+                    last = size - 1;
+                }
+            }
+            satisfiable = first < size;  // Else it starts past the end
+        }
+        if (satisfiable) {
+            ranges[count].first = first;
+            ranges[count].last = last;
+            count++;
+        }
+
+        p = skip_ows(p, end);
+        if (p < end && *p != ',') {
+            return HTTP_RANGE_IGNORE;
+        }
+    }
+    if (specs == 0) {
+        return HTTP_RANGE_IGNORE;
+    }
+    return count > 0 ? count : HTTP_RANGE_UNSATISFIABLE;
+}
+
+int http_etag_list_matches(const char *value, size_t len, const char *etag) {
+    const char *p = value;
+    const char *end = value + len;
+    size_t etag_len = strlen(etag);
+    while (1) {
+        p = skip_ows(p, end);
+        if (p < end && *p == ',') {
+            p++;
+            continue;
+        }
+        if (p == end) {
+            return 0;
+        }
+        if (*p == '*') {
+            return 1;
+        }
+        if (end - p >= 2 && p[0] == 'W' && p[1] == '/') {
+            p += 2;
+        }
+        const char *tag = p;
+        if (p == end || *p++ != '"') {
+            return 0;  // Malformed: treat as no match
+        }
+        while (p < end && *p != '"') {
+            p++;
+        }
+        if (p == end) {
+            return 0;
+        }
+        p++;
+        if ((size_t)(p - tag) == etag_len && memcmp(tag, etag, etag_len) == 0) {
+            return 1;
+        }
+    }
+}
+
+// "q=0.5" style weight after a ';' (other parameters are skipped): 0-1000
+static int parse_quality(const char *p, const char *end) {
+    int quality = 1000;
+    while (p < end && *p == ';') {
+        p = skip_ows(p + 1, end);
+        if (end - p >= 2 && (p[0] == 'q' || p[0] == 'Q') && p[1] == '=') {
+            p += 2;
+            quality = 0;
+            int scale = 1000;
+            if (p < end && (*p == '0' || *p == '1')) {
+                quality = (*p++ - '0') * 1000;
+            }
+            if (p < end && *p == '.') {
+                for (p++; p < end && *p >= '0' && *p <= '9' && scale > 1; p++) {
+                    scale /= 10;
+                    quality += (*p - '0') * scale;
+                }
+            }
+            if (quality > 1000) {
+                quality = 1000;
+            }
+        }
+        while (p < end && *p != ';') {
+            p++;
+        }
+    }
+    return quality;
+}
+
+int http_accept_encoding_quality(const char *value, size_t len, const char *coding) {
+    const char *p = value;
+    const char *end = value + len;
+    size_t coding_len = strlen(coding);
+    int wildcard = 0;
+    while (p < end) {
+        p = skip_ows(p, end);
+        const char *token = p;
+        while (p < end && *p != ',' && *p != ';' && *p != ' ' && *p != '\t') {
+            p++;
+        }
+        size_t token_len = p - token;
+        const char *params = skip_ows(p, end);
+        while (p < end && *p != ',') {
+            p++;
+        }
+        int quality = parse_quality(params, p);
+        if (token_len == coding_len && strncasecmp(token, coding, coding_len) == 0) {
+            return quality;
+        }
+        if (token_len == 1 && *token == '*') {
+            wildcard = quality;
+        }
+        if (p < end) {
+            p++;
+        }
+    }
+    return wildcard;
+}
+
+// Two digits at p, or -1
+static int parse_two_digits(const char *p) {
+    if (p[0] < '0' || p[0] > '9' || p[1] < '0' || p[1] > '9') {
+        return -1;
+    }
+    return (p[0] - '0') * 10 + (p[1] - '0');
+}
+
+int http_parse_date(const char *value, size_t len, time_t *time) {
+    static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    // "Sun, 06 Nov 1994 08:49:37 GMT"
+    if (len != 29 || value[3] != ',' || value[4] != ' ' || value[7] != ' ' || value[11] != ' ' ||
+        value[16] != ' ' || value[19] != ':' || value[22] != ':' || memcmp(value + 25, " GMT", 4) != 0) {
+        return -1;
+    }
+    int month = -1;
+    for (int i = 0; i < 12; i++) {
+        if (memcmp(value + 8, months + i * 3, 3) == 0) {
+            month = i + 1;
+            break;
+        }
+    }
+    int day = parse_two_digits(value + 5);
+    int century = parse_two_digits(value + 12);
+    int year_low = parse_two_digits(value + 14);
+    int hour = parse_two_digits(value + 17);
+    int minute = parse_two_digits(value + 20);
+    int second = parse_two_digits(value + 23);
+    if (month < 0 || day < 1 || day > 31 || century < 0 || year_low < 0 ||
+        hour < 0 || hour > 23 || minute < 0 || minute > 59 || second < 0 || second > 60) {
+        return -1;
+    }
+    long long year = century * 100 + year_low;
+
+    // Days since 1970-01-01 in the proleptic Gregorian calendar (no timegm())
+    long long y = year - (month <= 2);
+    long long era = y / 400;
+    long long year_of_era = y - era * 400;
+    long long day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    long long day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    long long days = era * 146097 + day_of_era - 719468;
+    *time = (time_t)(days * 86400 + hour * 3600 + minute * 60 + second);
+    return 0;
+}
+
+int http_parse_query(char *query, HttpQueryParam *params, int max_params) {
+    int count = 0;
+    char *pair = query;
+    while (*pair && count < max_params) {
+        char *end = pair + strcspn(pair, "&");
+        char *equal_sign = memchr(pair, '=', end - pair);
+        int last = *end == '\0';
+        *end = '\0';
+        if (equal_sign) {
+            *equal_sign = '\0';
+            http_url_decode(pair, pair, equal_sign - pair);
+            http_url_decode(equal_sign + 1, equal_sign + 1, end - equal_sign - 1);
+            params[count].key = pair;
+            params[count].value = equal_sign + 1;
+            count++;
+        }
+        if (last) {
+            break;
+        }
+        pair = end + 1;
+    }
+    return count;
+}
@@ -0,0 +1,111 @@
+#ifndef HTTP_PARSER_H
+#define HTTP_PARSER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+// Incremental HTTP/1.x request head parser
+//
+// The parser never copies request data. Method, target, version and every
+// header are recorded as (offset, length) slices into the caller's receive
+// buffer, so the buffer must keep the request's bytes at the same offsets
+// until the request has been handled. Call http_parser_execute() each time
+// more bytes arrive; it resumes where the previous call stopped.
+
+#define HTTP_MAX_HEADERS 64
+
+typedef struct {
+    uint32_t offset;
+    uint32_t length;
+} HttpSlice;
+
+typedef struct {
+    HttpSlice name;
+    HttpSlice value;
+} HttpHeaderField;
+
+typedef enum {
+    HTTP_PARSE_ERROR = -1,      // error_status holds the status to answer with
+    HTTP_PARSE_INCOMPLETE = 0,  // Need more bytes
+    HTTP_PARSE_DONE = 1         // head_length bytes form a complete request head
+} HttpParseResult;
+
+typedef struct {
+    size_t max_request_line;    // 414 URI Too Long beyond this
+    size_t max_header_bytes;    // 431 for a longer request head
+    int max_headers;            // 431 for more header fields (<= HTTP_MAX_HEADERS)
+    long long max_body;         // 413 for a larger Content-Length
+} HttpParserLimits;
+
+typedef struct {
+    int stage;                  // Which part of the head is being scanned
+    size_t line_start;          // Offset of the line being scanned
+    size_t scan_pos;            // Where the search for the line end resumes
+
+    HttpSlice method;
+    HttpSlice target;
+    HttpSlice version;
+    HttpHeaderField headers[HTTP_MAX_HEADERS];
+    int header_count;
+
+    size_t head_length;         // Request line + headers + blank line
+    long long content_length;   // -1 when there is no Content-Length
+    int error_status;           // 400, 413, 414, 431 or 501 after HTTP_PARSE_ERROR
+} HttpParser;
+
+// Reset the parser for a new request
+void http_parser_init(HttpParser *parser);
+
+// Parse data[0..len); data must start at the first byte of the request
+// and hold everything passed to the previous calls for this request
+HttpParseResult http_parser_execute(HttpParser *parser, const char *data, size_t len,
+                                    const HttpParserLimits *limits);
+
+// Compare a slice with a NUL terminated string
+int http_slice_equals(const char *data, HttpSlice slice, const char *str);
+int http_slice_equals_nocase(const char *data, HttpSlice slice, const char *str);
+
+// First header with the given name (case-insensitive), or NULL
+const HttpHeaderField *http_parser_header(const HttpParser *parser, const char *data, const char *name);
+
+// Byte ranges from a Range header, resolved against the representation size
+#define HTTP_MAX_RANGES 16
+
+typedef struct {
+    long long first;            // Offset of the first byte
+    long long last;             // Offset of the last byte (inclusive)
+} HttpRange;
+
+#define HTTP_RANGE_IGNORE 0           // Malformed, not bytes, or too many ranges: send it all
+#define HTTP_RANGE_UNSATISFIABLE (-1) // No range overlaps the representation: 416
+
+// Parse "bytes=first-last, first-, -suffix, ..." for a representation of
+// size bytes. Ranges past the end are dropped and the rest clamped.
+// Returns the number of ranges stored, HTTP_RANGE_IGNORE or HTTP_RANGE_UNSATISFIABLE
+int http_parse_range(const char *value, size_t len, long long size, HttpRange *ranges, int max_ranges);
+
+// Does an If-None-Match value ("*" or a list of entity-tags) match etag?
+// Uses the weak comparison, so W/"x" matches "x"
+int http_etag_list_matches(const char *value, size_t len, const char *etag);
+
+// Quality (0-1000) an Accept-Encoding value gives a content-coding, from
+// its own entry or else "*"; 0 means not acceptable
+int http_accept_encoding_quality(const char *value, size_t len, const char *coding);
+
+// Parse an IMF-fixdate ("Sun, 06 Nov 1994 08:49:37 GMT") into *time
+// Returns 0, or -1 if the value is not one (obsolete formats included)
+int http_parse_date(const char *value, size_t len, time_t *time);
+
+// One parameter of a query string; both point into the query it came from
+typedef struct {
+    const char *key;
+    const char *value;
+} HttpQueryParam;
+
+// Split a NUL terminated query string (the part after '?') in place on '&'
+// and '=', decoding each key and value. Pairs without '=' are skipped.
+// Returns the number of parameters stored, at most max_params
+int http_parse_query(char *query, HttpQueryParam *params, int max_params);
+
+#endif
@@ -0,0 +1,295 @@
+#include <string.h>
+#include "http_scan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HTTP_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+// Bytes that end a request head field: CTLs except tab, and DEL
+static const unsigned char ctl_chars[256] = {
+    [0x00] = 1, [0x01] = 1, [0x02] = 1, [0x03] = 1, [0x04] = 1, [0x05] = 1, [0x06] = 1, [0x07] = 1,
+    [0x08] = 1,             [0x0a] = 1, [0x0b] = 1, [0x0c] = 1, [0x0d] = 1, [0x0e] = 1, [0x0f] = 1,
+    [0x10] = 1, [0x11] = 1, [0x12] = 1, [0x13] = 1, [0x14] = 1, [0x15] = 1, [0x16] = 1, [0x17] = 1,
+    [0x18] = 1, [0x19] = 1, [0x1a] = 1, [0x1b] = 1, [0x1c] = 1, [0x1d] = 1, [0x1e] = 1, [0x1f] = 1,
+    [0x7f] = 1,
+};
+
+// RFC 9110 tchar: characters allowed in methods and header names
+static const unsigned char token_chars[256] = {
+    ['!'] = 1, ['#'] = 1, ['$'] = 1, ['%'] = 1, ['&'] = 1, ['\''] = 1, ['*'] = 1,
+    ['+'] = 1, ['-'] = 1, ['.'] = 1, ['^'] = 1, ['_'] = 1, ['`'] = 1, ['|'] = 1, ['~'] = 1,
+    ['0'] = 1, ['1'] = 1, ['2'] = 1, ['3'] = 1, ['4'] = 1, ['5'] = 1, ['6'] = 1, ['7'] = 1,
+    ['8'] = 1, ['9'] = 1,
+    ['A'] = 1, ['B'] = 1, ['C'] = 1, ['D'] = 1, ['E'] = 1, ['F'] = 1, ['G'] = 1, ['H'] = 1,
+    ['I'] = 1, ['J'] = 1, ['K'] = 1, ['L'] = 1, ['M'] = 1, ['N'] = 1, ['O'] = 1, ['P'] = 1,
+    ['Q'] = 1, ['R'] = 1, ['S'] = 1, ['T'] = 1, ['U'] = 1, ['V'] = 1, ['W'] = 1, ['X'] = 1,
+    ['Y'] = 1, ['Z'] = 1,
+    ['a'] = 1, ['b'] = 1, ['c'] = 1, ['d'] = 1, ['e'] = 1, ['f'] = 1, ['g'] = 1, ['h'] = 1,
+    ['i'] = 1, ['j'] = 1, ['k'] = 1, ['l'] = 1, ['m'] = 1, ['n'] = 1, ['o'] = 1, ['p'] = 1,
+    ['q'] = 1, ['r'] = 1, ['s'] = 1, ['t'] = 1, ['u'] = 1, ['v'] = 1, ['w'] = 1, ['x'] = 1,
+    ['y'] = 1, ['z'] = 1,
+};
+
+// Hex digit value + 1, so 0 means not a hex digit
+static const unsigned char hex_digits[256] = {
+    ['0'] = 1, ['1'] = 2, ['2'] = 3, ['3'] = 4, ['4'] = 5,
+    ['5'] = 6, ['6'] = 7, ['7'] = 8, ['8'] = 9, ['9'] = 10,
+    ['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16,
+    ['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16,
+};
+
+// ---------------------------------------------------------------------------
+// Scalar kernels (also finish the tail of the vector kernels)
+
+static size_t scan_ctl_scalar(const char *data, size_t start, size_t end) {
+    while (start < end && !ctl_chars[(unsigned char)data[start]]) {
+        start++;
+    }
+    return start;
+}
+
+static size_t scan_token_scalar(const char *data, size_t start, size_t end) {
+    while (start < end && token_chars[(unsigned char)data[start]]) {
+        start++;
+    }
+    return start;
+}
+
+static size_t scan_escape_scalar(const char *data, size_t start, size_t end) {
+    while (start < end && data[start] != '%' && data[start] != '+') {
+        start++;
+    }
+    return start;
+}
+
+#ifdef HTTP_SCAN_X86
+
+// ---------------------------------------------------------------------------
+// SSE2 kernels: each step classifies 16 bytes and turns the result into a
+// bitmask, so the first match is a count of trailing zeros away
+//
+// SSE2 only has signed byte compares; "x <= limit" (unsigned) is computed
+// as min(x, limit) == x.
+
+#define SSE2 __attribute__((target("sse2")))
+
+SSE2 static inline __m128i le_epu8_128(__m128i v, char limit) {
+    return _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(limit)), v);
+}
+
+// lo <= x <= hi, as x - lo <= hi - lo
+SSE2 static inline __m128i in_range_128(__m128i v, char lo, char hi) {
+    return le_epu8_128(_mm_sub_epi8(v, _mm_set1_epi8(lo)), (char)(hi - lo));
+}
+
+SSE2 static size_t scan_ctl_sse2(const char *data, size_t start, size_t end) {
+    for (; start + 16 <= end; start += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(data + start));
+        __m128i ctl = _mm_andnot_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\t')), le_epu8_128(v, 0x1f));
+        int mask = _mm_movemask_epi8(_mm_or_si128(ctl, _mm_cmpeq_epi8(v, _mm_set1_epi8(0x7f))));
+        if (mask) {
+            return start + __builtin_ctz(mask);
+        }
+    }
+    return scan_ctl_scalar(data, start, end);
+}
+
+// Non-token bytes: outside 0x21-0x7e, or one of the separators "(),/:;<=>?@[\]{}
+SSE2 static size_t scan_token_sse2(const char *data, size_t start, size_t end) {
+    for (; start + 16 <= end; start += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(data + start));
+        __m128i bad = _mm_or_si128(le_epu8_128(v, ' '), _mm_cmpeq_epi8(_mm_max_epu8(v, _mm_set1_epi8(0x7f)), v));
+        bad = _mm_or_si128(bad, in_range_128(v, '(', ')'));
+        bad = _mm_or_si128(bad, in_range_128(v, ':', '@'));
+        bad = _mm_or_si128(bad, in_range_128(v, '[', ']'));
+        bad = _mm_or_si128(bad, _mm_cmpeq_epi8(v, _mm_set1_epi8('"')));
+        bad = _mm_or_si128(bad, _mm_cmpeq_epi8(v, _mm_set1_epi8(',')));
+        bad = _mm_or_si128(bad, _mm_cmpeq_epi8(v, _mm_set1_epi8('/')));
+        bad = _mm_or_si128(bad, _mm_cmpeq_epi8(v, _mm_set1_epi8('{')));
+        bad = _mm_or_si128(bad, _mm_cmpeq_epi8(v, _mm_set1_epi8('}')));
+        int mask = _mm_movemask_epi8(bad);
+        if (mask) {
+            return start + __builtin_ctz(mask);
+        }
+    }
+    return scan_token_scalar(data, start, end);
+}
+
+SSE2 static size_t scan_escape_sse2(const char *data, size_t start, size_t end) {
+    for (; start + 16 <= end; start += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(data + start));
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('%')),
+                                                  _mm_cmpeq_epi8(v, _mm_set1_epi8('+'))));
+        if (mask) {
+            return start + __builtin_ctz(mask);
+        }
+    }
+    return scan_escape_scalar(data, start, end);
+}
+
+// ---------------------------------------------------------------------------
+// AVX2 kernels: the SSE2 kernels 32 bytes at a time
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 static inline __m256i le_epu8_256(__m256i v, char limit) {
+    return _mm256_cmpeq_epi8(_mm256_min_epu8(v, _mm256_set1_epi8(limit)), v);
+}
+
+AVX2 static inline __m256i in_range_256(__m256i v, char lo, char hi) {
+    return le_epu8_256(_mm256_sub_epi8(v, _mm256_set1_epi8(lo)), (char)(hi - lo));
+}
+
+AVX2 static size_t scan_ctl_avx2(const char *data, size_t start, size_t end) {
+    for (; start + 32 <= end; start += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(data + start));
+        __m256i ctl = _mm256_andnot_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')), le_epu8_256(v, 0x1f));
+        unsigned mask = _mm256_movemask_epi8(_mm256_or_si256(ctl, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(0x7f))));
+        if (mask) {
+            return start + __builtin_ctz(mask);
+        }
+    }
+    return scan_ctl_sse2(data, start, end);
+}
+
+AVX2 static size_t scan_token_avx2(const char *data, size_t start, size_t end) {
+    for (; start + 32 <= end; start += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(data + start));
+        __m256i bad = _mm256_or_si256(le_epu8_256(v, ' '),
+                                      _mm256_cmpeq_epi8(_mm256_max_epu8(v, _mm256_set1_epi8(0x7f)), v));
+        bad = _mm256_or_si256(bad, in_range_256(v, '(', ')'));
+        bad = _mm256_or_si256(bad, in_range_256(v, ':', '@'));
+        bad = _mm256_or_si256(bad, in_range_256(v, '[', ']'));
+        bad = _mm256_or_si256(bad, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')));
+        bad = _mm256_or_si256(bad, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(',')));
+        bad = _mm256_or_si256(bad, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('/')));
+        bad = _mm256_or_si256(bad, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('{')));
+        bad = _mm256_or_si256(bad, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('}')));
+        unsigned mask = _mm256_movemask_epi8(bad);
+        if (mask) {
+            return start + __builtin_ctz(mask);
+        }
+    }
+    return scan_token_sse2(data, start, end);
+}
+
+AVX2 static size_t scan_escape_avx2(const char *data, size_t start, size_t end) {
+    for (; start + 32 <= end; start += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(data + start));
+        unsigned mask = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('%')),
+                                                             _mm256_cmpeq_epi8(v, _mm256_set1_epi8('+'))));
+        if (mask) {
+            return start + __builtin_ctz(mask);
+        }
+    }
+    return scan_escape_sse2(data, start, end);
+}
+
+#endif
+
+// ---------------------------------------------------------------------------
+// Runtime dispatch
+
+typedef struct {
+    const char *name;
+    size_t (*scan_ctl)(const char *data, size_t start, size_t end);
+    size_t (*scan_token)(const char *data, size_t start, size_t end);
+    size_t (*scan_escape)(const char *data, size_t start, size_t end);
+} ScanKernels;
+
+static const ScanKernels scalar_kernels = { "scalar", scan_ctl_scalar, scan_token_scalar, scan_escape_scalar };
+#ifdef HTTP_SCAN_X86
+static const ScanKernels sse2_kernels = { "sse2", scan_ctl_sse2, scan_token_sse2, scan_escape_sse2 };
+static const ScanKernels avx2_kernels = { "avx2", scan_ctl_avx2, scan_token_avx2, scan_escape_avx2 };
+#endif
+
+static const ScanKernels *active_kernels;
+
+static int cpu_supports(const ScanKernels *kernels) {
+#ifdef HTTP_SCAN_X86
+    __builtin_cpu_init();
+    if (kernels == &avx2_kernels) {
+        return __builtin_cpu_supports("avx2");
+    }
+    if (kernels == &sse2_kernels) {
+        return __builtin_cpu_supports("sse2");
+    }
+#endif
+    return kernels == &scalar_kernels;
+}
+
+static const ScanKernels *kernels(void) {
+    if (!active_kernels) {
+        active_kernels = &scalar_kernels;
+#ifdef HTTP_SCAN_X86
+        if (cpu_supports(&avx2_kernels)) {
+            active_kernels = &avx2_kernels;
+        } else if (cpu_supports(&sse2_kernels)) {
+            active_kernels = &sse2_kernels;
+        }
+#endif
+    }
+    return active_kernels;
+}
+
+int http_scan_select(const char *name) {
+    const ScanKernels *all[] = {
+        &scalar_kernels,
+#ifdef HTTP_SCAN_X86
+        &sse2_kernels, &avx2_kernels,
+#endif
+    };
+    for (size_t i = 0; i < sizeof(all) / sizeof(all[0]); i++) {
+        if (strcmp(all[i]->name, name) == 0 && cpu_supports(all[i])) {
+            active_kernels = all[i];
+            return 1;
+        }
+    }
+    return 0;
+}
+
+const char *http_scan_implementation(void) {
+    return kernels()->name;
+}
+
+size_t http_scan_ctl(const char *data, size_t start, size_t end) {
+    return kernels()->scan_ctl(data, start, end);
+}
+
+size_t http_scan_token(const char *data, size_t start, size_t end) {
+    return kernels()->scan_token(data, start, end);
+}
+
+size_t http_url_decode(char *dst, const char *src, size_t len) {
+    const ScanKernels *scan = kernels();
+    size_t in = 0;
+    size_t out = 0;
+    while (in < len) {
+        // Copy the run up to the next escape in one go
+        size_t next = scan->scan_escape(src, in, len);
+        if (dst + out != src + in) {
+            memmove(dst + out, src + in, next - in);
+        }
+        out += next - in;
+        in = next;
+        if (in == len) {
+            break;
+        }
+
+        if (src[in] == '+') {
+            dst[out++] = ' ';
+            in++;
+        } else if (in + 2 < len && hex_digits[(unsigned char)src[in + 1]] &&
+                   hex_digits[(unsigned char)src[in + 2]]) {
+            int high = hex_digits[(unsigned char)src[in + 1]] - 1;
+            int low = hex_digits[(unsigned char)src[in + 2]] - 1;
+            dst[out++] = (char)(high << 4 | low);
+            in += 3;
+        } else {
+            dst[out++] = src[in++];  // Not a valid escape - keep the '%'
+        }
+    }
+    dst[out] = '\0';
+    return out;
+}
@@ -0,0 +1,32 @@
+#ifndef HTTP_SCAN_H
+#define HTTP_SCAN_H
+
+#include <stddef.h>
+
+// Byte scanning kernels for the request hot path
+//
+// Every kernel has a scalar, an SSE2 (16 bytes per step) and an AVX2
+// (32 bytes per step) version. The fastest one the CPU supports is picked
+// by feature detection the first time any of them is called.
+
+// Offset of the first control character other than tab (so CR and LF
+// included) or DEL in data[start, end), or end if there is none
+size_t http_scan_ctl(const char *data, size_t start, size_t end);
+
+// Offset of the first byte in data[start, end) that is not an RFC 9110
+// token character, or end if there is none
+size_t http_scan_token(const char *data, size_t start, size_t end);
+
+// Decode %XX escapes and '+' in src[0, len) into dst, which may be src
+// Invalid escapes are copied as-is. dst is NUL terminated and needs room
+// for len + 1 bytes; returns the decoded length.
+size_t http_url_decode(char *dst, const char *src, size_t len);
+
+// Force an implementation: "scalar", "sse2" or "avx2"
+// Returns 0 if it is unknown or the CPU does not support it
+int http_scan_select(const char *name);
+
+// Name of the implementation in use
+const char *http_scan_implementation(void);
+
+#endif
@@ -0,0 +1,114 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "mem_pool.h"
+
+#define ARENA_ALIGN 8
+
+AllocCounters alloc_counters;
+
+void *counted_malloc(size_t size) {
+    void *ptr = malloc(size);
+    if (ptr) {
+        alloc_counters.mallocs++;
+    }
+    return ptr;
+}
+
+void *counted_calloc(size_t count, size_t size) {
+    void *ptr = calloc(count, size);
+    if (ptr) {
+        alloc_counters.mallocs++;
+    }
+    return ptr;
+}
+
+void counted_free(void *ptr) {
+    if (ptr) {
+        alloc_counters.frees++;
+        free(ptr);
+    }
+}
+
+// Free buffers are linked through their first bytes
+typedef struct FreeBuffer {
+    struct FreeBuffer *next;
+} FreeBuffer;
+
+void buffer_pool_init(BufferPool *pool, size_t buffer_size, size_t max_free) {
+    pool->buffer_size = buffer_size < sizeof(FreeBuffer) ? sizeof(FreeBuffer) : buffer_size;
+    pool->max_free = max_free;
+    pool->free_list = NULL;
+    pool->free_count = 0;
+    pool->in_use = 0;
+    pool->reuses = 0;
+}
+
+void *buffer_pool_get(BufferPool *pool) {
+    FreeBuffer *buffer = pool->free_list;
+    if (buffer) {
+        pool->free_list = buffer->next;
+        pool->free_count--;
+        pool->reuses++;
+    } else if ((buffer = counted_malloc(pool->buffer_size)) == NULL) {
+        return NULL;
+    }
+    pool->in_use++;
+    return buffer;
+}
+
+void buffer_pool_put(BufferPool *pool, void *buffer) {
+    if (!buffer) {
+        return;
+    }
+    pool->in_use--;
+    if (pool->free_count >= pool->max_free) {
+        counted_free(buffer);
+        return;
+    }
+    FreeBuffer *node = buffer;
+    node->next = pool->free_list;
+    pool->free_list = node;
+    pool->free_count++;
+}
+
+void arena_attach(Arena *arena, void *memory, size_t size) {
+    arena->base = memory;
+    arena->size = memory ? size : 0;
+    arena->used = 0;
+}
+
+void *arena_alloc(Arena *arena, size_t size) {
+    size_t start = (arena->used + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    if (!arena->base || start > arena->size || size > arena->size - start) {
+        return NULL;
+    }
+    arena->used = start + size;
+    return arena->base + start;
+}
+
+void arena_reset(Arena *arena) {
+    arena->used = 0;
+}
+
+size_t arena_remaining(const Arena *arena) {
+    return arena->size - arena->used;
+}
+
+char *arena_printf(Arena *arena, int *len, const char *format, ...) {
+    size_t start = (arena->used + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    if (!arena->base || start >= arena->size) {
+        return NULL;
+    }
+    char *out = arena->base + start;
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(out, arena->size - start, format, args);
+    va_end(args);
+    if (written < 0 || (size_t)written >= arena->size - start) {
+        return NULL;  // Did not fit - nothing is allocated
+    }
+    arena_alloc(arena, written + 1);
+    *len = written;
+    return out;
+}
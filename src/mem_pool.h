@@ -0,0 +1,57 @@
+#ifndef MEM_POOL_H
+#define MEM_POOL_H
+
+#include <stddef.h>
+
+// Memory for the request path: buffer pools, per-connection arenas and
+// counters for every heap allocation the server makes
+//
+// Everything that would otherwise be malloc'd per connection or per request
+// comes from a BufferPool (fixed-size buffers recycled through a free list)
+// or from a connection's Arena (bump allocation inside one pooled buffer,
+// reset when the response batch has been sent). Once the pools have grown
+// to the peak load, serving requests does not touch the heap.
+
+// Heap allocations made through counted_malloc/counted_calloc/counted_free
+typedef struct {
+    unsigned long mallocs;
+    unsigned long frees;
+} AllocCounters;
+
+extern AllocCounters alloc_counters;
+
+void *counted_malloc(size_t size);
+void *counted_calloc(size_t count, size_t size);
+void counted_free(void *ptr);
+
+// Free list of buffers that are all buffer_size bytes
+typedef struct {
+    size_t buffer_size;
+    size_t max_free;            // Free buffers kept for reuse; the rest go back to the heap
+    void *free_list;
+    size_t free_count;
+    size_t in_use;
+    unsigned long reuses;       // Buffers handed out without a malloc
+} BufferPool;
+
+void buffer_pool_init(BufferPool *pool, size_t buffer_size, size_t max_free);
+void *buffer_pool_get(BufferPool *pool);    // NULL if the heap is exhausted
+void buffer_pool_put(BufferPool *pool, void *buffer);
+
+// Bump allocator over caller-provided memory; allocations are 8-byte aligned
+typedef struct {
+    char *base;                 // NULL while the arena has no memory attached
+    size_t size;
+    size_t used;
+} Arena;
+
+void arena_attach(Arena *arena, void *memory, size_t size);
+void *arena_alloc(Arena *arena, size_t size);   // NULL when the arena is full
+void arena_reset(Arena *arena);
+size_t arena_remaining(const Arena *arena);
+
+// snprintf into the arena; stores the length (without the NUL) in *len
+char *arena_printf(Arena *arena, int *len, const char *format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+#endif
@@ -0,0 +1,197 @@
+#define _GNU_SOURCE
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "metrics.h"
+
+// Until metrics_init() runs (and in tools that never call it) recording
+// goes to a private shard that is never exported
+static MetricsShard private_shard;
+MetricsShard *metrics_shard = &private_shard;
+
+static MetricsShard *shards;
+static int shards_mapped;
+
+static const char *stage_names[STAGE_COUNT] = {
+    "accept_to_first_byte",
+    "read_to_parsed",
+    "parsed_to_first_write",
+    "first_write_to_done",
+    "request_total",
+};
+
+static const char *method_names[METHOD_COUNT] = { "GET", "HEAD", "POST", "OTHER", "NONE" };
+
+// Prometheus bucket bounds in seconds; each is the cumulative count of the
+// HDR buckets that lie entirely at or below it
+static const double bucket_bounds[] = {
+    0.000005, 0.00001, 0.000025, 0.00005, 0.0001, 0.00025, 0.0005,
+    0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10,
+};
+#define BOUND_COUNT (sizeof(bucket_bounds) / sizeof(bucket_bounds[0]))
+
+static const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+#define QUANTILE_COUNT (sizeof(quantiles) / sizeof(quantiles[0]))
+
+int metrics_init(int shard_count) {
+    if (shard_count < 1) {
+        shard_count = 1;
+    }
+    void *memory = mmap(NULL, sizeof(MetricsShard) * shard_count, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        return -1;
+    }
+    shards = memory;
+    shards_mapped = shard_count;
+    metrics_shard = &shards[0];
+    return 0;
+}
+
+void metrics_select_shard(int shard) {
+    if (!shards) {
+        return;
+    }
+    metrics_shard = &shards[shard % shards_mapped];
+    __atomic_store_n(&metrics_shard->connections_active, 0, __ATOMIC_RELAXED);
+}
+
+static uint64_t load(const uint64_t *counter) {
+    return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+// Appends to the output buffer, remembering if it ever ran out of room
+typedef struct {
+    char *buf;
+    size_t capacity;
+    size_t len;
+    int overflow;
+} Output;
+
+static void emit(Output *out, const char *format, ...) __attribute__((format(printf, 2, 3)));
+static void emit(Output *out, const char *format, ...) {
+    if (out->overflow) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(out->buf + out->len, out->capacity - out->len, format, args);
+    va_end(args);
+    if (written < 0 || (size_t)written >= out->capacity - out->len) {
+        out->overflow = 1;
+        return;
+    }
+    out->len += written;
+}
+
+static uint64_t sum_counter(size_t offset) {
+    uint64_t total = 0;
+    for (int i = 0; i < shards_mapped; i++) {
+        total += load((const uint64_t *)((const char *)&shards[i] + offset));
+    }
+    return total;
+}
+
+static void render_stage(Output *out, int stage, Histogram *merged) {
+    memset(merged, 0, sizeof(*merged));
+    for (int i = 0; i < shards_mapped; i++) {
+        const Histogram *histogram = &shards[i].stages[stage];
+        for (int b = 0; b < METRICS_BUCKETS; b++) {
+            merged->counts[b] += load(&histogram->counts[b]);
+        }
+        merged->sum_ns += load(&histogram->sum_ns);
+    }
+    // The total comes from the buckets so the exported counts agree with each other
+    for (int b = 0; b < METRICS_BUCKETS; b++) {
+        merged->total += merged->counts[b];
+    }
+
+    uint64_t cumulative = 0;
+    int bucket = 0;
+    for (size_t i = 0; i < BOUND_COUNT; i++) {
+        uint64_t bound_ns = (uint64_t)(bucket_bounds[i] * 1e9);
+        while (bucket < METRICS_BUCKETS && metrics_bucket_upper_bound(bucket) <= bound_ns) {
+            cumulative += merged->counts[bucket++];
+        }
+        emit(out, "http_stage_duration_seconds_bucket{stage=\"%s\",le=\"%g\"} %llu\n",
+             stage_names[stage], bucket_bounds[i], (unsigned long long)cumulative);
+    }
+    emit(out, "http_stage_duration_seconds_bucket{stage=\"%s\",le=\"+Inf\"} %llu\n",
+         stage_names[stage], (unsigned long long)merged->total);
+    emit(out, "http_stage_duration_seconds_sum{stage=\"%s\"} %.9f\n",
+         stage_names[stage], merged->sum_ns / 1e9);
+    emit(out, "http_stage_duration_seconds_count{stage=\"%s\"} %llu\n",
+         stage_names[stage], (unsigned long long)merged->total);
+}
+
+// Quantiles at full HDR resolution, reported as the bucket's upper bound
+static void render_quantiles(Output *out, int stage, const Histogram *merged) {
+    for (size_t q = 0; q < QUANTILE_COUNT; q++) {
+        uint64_t rank = (uint64_t)(quantiles[q] * merged->total + 0.5);
+        if (rank == 0) {
+            rank = 1;
+        }
+        uint64_t cumulative = 0;
+        uint64_t value = 0;
+        for (int b = 0; b < METRICS_BUCKETS && merged->total > 0; b++) {
+            cumulative += merged->counts[b];
+            if (cumulative >= rank) {
+                value = metrics_bucket_upper_bound(b);
+                break;
+            }
+        }
+        emit(out, "http_stage_duration_quantile_seconds{stage=\"%s\",quantile=\"%g\"} %.9f\n",
+             stage_names[stage], quantiles[q], value / 1e9);
+    }
+}
+
+int metrics_render(char *buf, size_t capacity) {
+    Output out = { buf, capacity, 0, 0 };
+    if (!shards) {
+        return 0;
+    }
+
+    emit(&out, "# HELP http_requests_total Requests answered, by method.\n"
+               "# TYPE http_requests_total counter\n");
+    for (int m = 0; m < METHOD_COUNT; m++) {
+        emit(&out, "http_requests_total{method=\"%s\"} %llu\n", method_names[m],
+             (unsigned long long)sum_counter(offsetof(MetricsShard, requests) + m * sizeof(uint64_t)));
+    }
+
+    emit(&out, "# HELP http_responses_total Responses sent, by status code.\n"
+               "# TYPE http_responses_total counter\n");
+    for (int code = METRICS_MIN_STATUS; code <= METRICS_MAX_STATUS; code++) {
+        uint64_t count = sum_counter(offsetof(MetricsShard, responses) +
+                                     (code - METRICS_MIN_STATUS) * sizeof(uint64_t));
+        if (count > 0) {
+            emit(&out, "http_responses_total{code=\"%d\"} %llu\n", code, (unsigned long long)count);
+        }
+    }
+
+    emit(&out, "# HELP http_sent_bytes_total Bytes written to client sockets.\n"
+               "# TYPE http_sent_bytes_total counter\n"
+               "http_sent_bytes_total %llu\n",
+         (unsigned long long)sum_counter(offsetof(MetricsShard, bytes_sent)));
+    emit(&out, "# HELP http_connections_accepted_total Connections accepted.\n"
+               "# TYPE http_connections_accepted_total counter\n"
+               "http_connections_accepted_total %llu\n",
+         (unsigned long long)sum_counter(offsetof(MetricsShard, connections_accepted)));
+    emit(&out, "# HELP http_connections_active Connections currently open.\n"
+               "# TYPE http_connections_active gauge\n"
+               "http_connections_active %llu\n",
+         (unsigned long long)sum_counter(offsetof(MetricsShard, connections_active)));
+
+    static Histogram merged[STAGE_COUNT];
+    emit(&out, "# HELP http_stage_duration_seconds Time spent in each stage of a request.\n"
+               "# TYPE http_stage_duration_seconds histogram\n");
+    for (int stage = 0; stage < STAGE_COUNT; stage++) {
+        render_stage(&out, stage, &merged[stage]);
+    }
+    emit(&out, "# HELP http_stage_duration_quantile_seconds Stage duration quantiles (within 6.25%%).\n"
+               "# TYPE http_stage_duration_quantile_seconds gauge\n");
+    for (int stage = 0; stage < STAGE_COUNT; stage++) {
+        render_quantiles(&out, stage, &merged[stage]);
+    }
+    return out.overflow ? -1 : (int)out.len;
+}
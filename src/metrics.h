@@ -0,0 +1,126 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+// Server metrics: per-stage latency histograms, response counters and
+// connection gauges, exported in Prometheus text format
+//
+// Every worker process records into its own shard of a MAP_SHARED mapping
+// created before fork(), so any worker can answer a scrape with the totals
+// of all of them. A shard has exactly one writer, so recording is a plain
+// load + store (no lock, no atomic read-modify-write); readers use relaxed
+// atomic loads and may see a scrape that is a few events behind.
+//
+// Histograms are HDR-style log-linear: 16 sub-buckets per power of two of
+// nanoseconds, so any recorded value is within 1/16 (6.25%) of its bucket
+// bounds, from 1ns up to 2^41ns (about 36 minutes, larger values clamp).
+
+#define METRICS_SUB_BUCKET_BITS 4
+#define METRICS_SUB_BUCKETS (1 << METRICS_SUB_BUCKET_BITS)
+#define METRICS_MAX_BIT 40
+#define METRICS_BUCKETS ((METRICS_MAX_BIT - METRICS_SUB_BUCKET_BITS + 2) * METRICS_SUB_BUCKETS)
+
+// Request lifecycle: accept -> first byte read -> head parsed ->
+// first response byte written -> response batch fully sent
+typedef enum {
+    STAGE_ACCEPT_TO_FIRST_BYTE,     // First request on a connection only
+    STAGE_READ_TO_PARSED,
+    STAGE_PARSED_TO_FIRST_WRITE,
+    STAGE_FIRST_WRITE_TO_DONE,
+    STAGE_REQUEST_TOTAL,            // First byte read -> done
+    STAGE_COUNT
+} MetricsStage;
+
+typedef enum {
+    METHOD_GET,
+    METHOD_HEAD,
+    METHOD_POST,
+    METHOD_OTHER,
+    METHOD_NONE,                    // The request line never parsed
+    METHOD_COUNT
+} MetricsMethod;
+
+#define METRICS_MIN_STATUS 100
+#define METRICS_MAX_STATUS 599
+
+typedef struct {
+    uint64_t counts[METRICS_BUCKETS];
+    uint64_t total;
+    uint64_t sum_ns;
+} Histogram;
+
+typedef struct {
+    Histogram stages[STAGE_COUNT];
+    uint64_t requests[METHOD_COUNT];
+    uint64_t responses[METRICS_MAX_STATUS - METRICS_MIN_STATUS + 1];
+    uint64_t bytes_sent;
+    uint64_t connections_accepted;
+    uint64_t connections_active;
+} MetricsShard;
+
+// This process's shard (see metrics_select_shard)
+extern MetricsShard *metrics_shard;
+
+// Map shard_count shards before forking; returns -1 with errno set on failure
+int metrics_init(int shard_count);
+
+// Record into the given shard from now on; a restarted worker reuses its
+// predecessor's shard, keeping the counters and clearing the gauges
+void metrics_select_shard(int shard);
+
+// Render every shard's totals as Prometheus text into buf
+// Returns the length, or -1 if it did not fit
+int metrics_render(char *buf, size_t capacity);
+
+// Monotonic nanoseconds for stage timestamps (vDSO, no syscall)
+static inline uint64_t metrics_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+// Single writer per shard: a relaxed store of the new value is enough
+static inline void metrics_add(uint64_t *counter, uint64_t n) {
+    __atomic_store_n(counter, *counter + n, __ATOMIC_RELAXED);
+}
+
+static inline int metrics_bucket(uint64_t value) {
+    if (value < (2u << METRICS_SUB_BUCKET_BITS)) {
+        return (int)value;          // Linear below 32ns
+    }
+    int bit = 63 - __builtin_clzll(value);
+    if (bit > METRICS_MAX_BIT) {
+        return METRICS_BUCKETS - 1;
+    }
+    int shift = bit - METRICS_SUB_BUCKET_BITS;
+    return shift * METRICS_SUB_BUCKETS + (int)(value >> shift);
+}
+
+// Largest value that lands in a bucket
+static inline uint64_t metrics_bucket_upper_bound(int bucket) {
+    if (bucket < 2 * METRICS_SUB_BUCKETS) {
+        return bucket;
+    }
+    int shift = bucket / METRICS_SUB_BUCKETS - 1;
+    uint64_t sub_bucket = bucket % METRICS_SUB_BUCKETS + METRICS_SUB_BUCKETS;
+    return ((sub_bucket + 1) << shift) - 1;
+}
+
+static inline void metrics_record(MetricsStage stage, uint64_t nanoseconds) {
+    Histogram *histogram = &metrics_shard->stages[stage];
+    metrics_add(&histogram->counts[metrics_bucket(nanoseconds)], 1);
+    metrics_add(&histogram->total, 1);
+    metrics_add(&histogram->sum_ns, nanoseconds);
+}
+
+static inline void metrics_count_response(MetricsMethod method, int status_code) {
+    metrics_add(&metrics_shard->requests[method], 1);
+    if (status_code >= METRICS_MIN_STATUS && status_code <= METRICS_MAX_STATUS) {
+        metrics_add(&metrics_shard->responses[status_code - METRICS_MIN_STATUS], 1);
+    }
+}
+
+#endif
@@ -0,0 +1,122 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <string.h>
+#include "mime.h"
+#include "mime_hash.h"
+
+typedef struct {
+    const char *ext;
+    size_t len;
+    const char *type;
+} MimeEntry;
+
+// mime_seeds, mime_table, MIME_TABLE_SIZE and MIME_BUCKET_COUNT,
+// generated from src/mime.types by tools/mime_gen.c
+#include "mime_table.h"
+
+#define MIME_OVERRIDE_SLOTS 256     // Open addressing, kept under 3/4 full
+#define MIME_MAX_TYPE 128
+
+typedef struct {
+    char ext[MIME_MAX_EXTENSION + 1];
+    size_t len;
+    char type[MIME_MAX_TYPE];
+} MimeOverride;
+
+static MimeOverride overrides[MIME_OVERRIDE_SLOTS];
+static int override_count;
+
+// ext is lowercase here
+static const char *find_override(const char *ext, size_t len, uint64_t hash) {
+    size_t slot = hash & (MIME_OVERRIDE_SLOTS - 1);
+    while (overrides[slot].len) {
+        if (overrides[slot].len == len && memcmp(overrides[slot].ext, ext, len) == 0) {
+            return overrides[slot].type;
+        }
+        slot = (slot + 1) & (MIME_OVERRIDE_SLOTS - 1);
+    }
+    return NULL;
+}
+
+const char *mime_type_for_path(const char *path) {
+    // The extension is whatever follows the last '.' of the last path segment
+    const char *dot = strrchr(path, '.');
+    if (!dot || strchr(dot, '/')) {
+        return MIME_DEFAULT_TYPE;
+    }
+    const char *ext = dot + 1;
+    size_t len = strlen(ext);
+    if (len == 0 || len > MIME_MAX_EXTENSION) {
+        return MIME_DEFAULT_TYPE;
+    }
+
+    char lower[MIME_MAX_EXTENSION + 1];
+    uint64_t hash = mime_hash(ext, len, lower);
+    if (override_count > 0) {
+        const char *type = find_override(lower, len, hash);
+        if (type) {
+            return type;
+        }
+    }
+
+    uint32_t seed = mime_seeds[mime_bucket(hash, MIME_BUCKET_COUNT)];
+    const MimeEntry *entry = &mime_table[mime_slot(hash, seed, MIME_TABLE_SIZE)];
+    if (entry->len == len && memcmp(entry->ext, lower, len) == 0) {
+        return entry->type;
+    }
+    return MIME_DEFAULT_TYPE;
+}
+
+static int add_override(const char *ext, const char *type) {
+    size_t len = strlen(ext);
+    if (len == 0 || len > MIME_MAX_EXTENSION || strlen(type) >= MIME_MAX_TYPE) {
+        fprintf(stderr, "MIME override skipped: %s %s\n", type, ext);
+        return 0;
+    }
+    char lower[MIME_MAX_EXTENSION + 1];
+    size_t slot = mime_hash(ext, len, lower) & (MIME_OVERRIDE_SLOTS - 1);
+    while (overrides[slot].len &&
+           !(overrides[slot].len == len && memcmp(overrides[slot].ext, lower, len) == 0)) {
+        slot = (slot + 1) & (MIME_OVERRIDE_SLOTS - 1);
+    }
+    if (!overrides[slot].len) {
+        if (override_count >= MIME_OVERRIDE_SLOTS * 3 / 4) {
+            fprintf(stderr, "Too many MIME overrides, skipping %s\n", ext);
+            return 0;
+        }
+        override_count++;
+    }
+    memcpy(overrides[slot].ext, lower, len + 1);
+    overrides[slot].len = len;
+    snprintf(overrides[slot].type, sizeof(overrides[slot].type), "%s", type);
+    return 1;
+}
+
+int mime_load_overrides(const char *file_name) {
+    FILE *file = fopen(file_name, "r");
+    if (!file) {
+        return -1;
+    }
+    int loaded = 0;
+    char line[1024];
+    while (fgets(line, sizeof(line), file)) {
+        char *comment = strchr(line, '#');
+        if (comment) {
+            *comment = '\0';
+        }
+        char *saveptr = NULL;
+        char *type = strtok_r(line, " \t\r\n", &saveptr);
+        char *ext;
+        while (type && (ext = strtok_r(NULL, " \t\r\n", &saveptr)) != NULL) {
+            loaded += add_override(ext, type);
+        }
+    }
+    fclose(file);
+    return loaded;
+}
+
+int mime_is_compressible(const char *content_type) {
+    return strncmp(content_type, "text/", 5) == 0 || strstr(content_type, "javascript") ||
+           strstr(content_type, "json") || strstr(content_type, "xml") ||
+           strcmp(content_type, "application/wasm") == 0;
+}
@@ -0,0 +1,23 @@
+#ifndef MIME_H
+#define MIME_H
+
+// Content-Type lookup by file extension
+//
+// The built-in types come from src/mime.types, compiled into a perfect-hash
+// table at build time, so a lookup costs two hashes of the extension and
+// one comparison. Overrides loaded at startup are checked first.
+
+#define MIME_DEFAULT_TYPE "application/octet-stream"
+
+// Content-Type for a file path (case-insensitive); MIME_DEFAULT_TYPE when
+// the extension is unknown or there is none
+const char *mime_type_for_path(const char *path);
+
+// Types that shrink under gzip/brotli (text, JSON, XML, JavaScript, SVG, wasm)
+int mime_is_compressible(const char *content_type);
+
+// Add or replace types from a file in mime.types format
+// Returns the number of extensions loaded, or -1 if the file can't be read
+int mime_load_overrides(const char *file_name);
+
+#endif
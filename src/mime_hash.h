@@ -0,0 +1,42 @@
+#ifndef MIME_HASH_H
+#define MIME_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Hashing shared by the MIME table generator (tools/mime_gen.c) and the
+// lookup in mime.c, so both place an extension in the same slot
+
+#define MIME_MAX_EXTENSION 16   // Longer extensions are never in the table
+
+// Case-insensitive 64-bit FNV-1a over the extension; the lowercased
+// extension is written to lower (len + 1 bytes) for the final comparison
+static inline uint64_t mime_hash(const char *ext, size_t len, char *lower) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = ext[i];
+        if (c >= 'A' && c <= 'Z') {
+            c += 'a' - 'A';
+        }
+        lower[i] = c;
+        hash = (hash ^ c) * 1099511628211ULL;
+    }
+    lower[len] = '\0';
+    return hash;
+}
+
+// First level: which bucket (and so which seed) the extension uses
+static inline uint32_t mime_bucket(uint64_t hash, uint32_t bucket_count) {
+    return (uint32_t)(hash >> 32) & (bucket_count - 1);
+}
+
+// Second level: the slot for a given seed, without rehashing the bytes
+static inline uint32_t mime_slot(uint64_t hash, uint32_t seed, uint32_t table_size) {
+    uint64_t x = hash ^ (seed * 0x9e3779b97f4a7c15ULL);
+    x ^= x >> 29;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 32;
+    return (uint32_t)x & (table_size - 1);
+}
+
+#endif
@@ -0,0 +1,173 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <string.h>
+#include "phase5_parsing.h"
+
+// URL decode helper function - decodes percent-encoded characters in-place
+// Converts %XX hex codes to ASCII characters and + to space
+void url_decode(char *path) {
+    int i = 0;  // Read position
+    int j = 0;  // Write position
+    
+    while (path[i] != '\0') {
+        if (path[i] == '%' && path[i+1] && path[i+2]) {
+            // Found %XX - convert hex to character
+            char hex[3] = {path[i+1], path[i+2], '\0'};
+            path[j] = (char)strtol(hex, NULL, 16);
+            i += 3;  // Skip past %XX
+            j++;
+        } else if (path[i] == '+') {
+            // Convert + to space
+            path[j] = ' ';
+            i++;
+            j++;
+        } else {
+            // Regular character - copy as-is
+            path[j] = path[i];
+            i++;
+            j++;
+        }
+    }
+    path[j] = '\0';  // Null terminate at final length
+}
+
+/*
+// Parse query string from path and populate QueryString struct
+// Example: "/search?q=hello&page=2" becomes path="/search" + query params
+// Modifies path in-place to remove query string portion
+// Returns number of parameters parsed
+"/search?q=hello&page=2"
+         ↓ (terminate at '?')
+path = "/search"
+query_start → "q=hello&page=2"
+         ↓ (split BY '&')
+token 1: "q=hello"
+token 2: "page=2"
+         ↓ (find '=' in each token)
+token 1: "q" = "hello"
+         ↓ (copy both)
+query->params[0].key = "q"
+query->params[0].value = "hello"
+*/
+int parse_query_string(char *path, QueryString *query) {
+    query->param_count = 0;
+    
+    // Search through path to find '?' character
+    for (size_t i = 0; path[i] != '\0'; i++) {
+        if (path[i] == '?') {
+            // Found query string separator
+            // Terminate path at '?' so path only contains the file path
+            path[i] = '\0';  // "/search?q=hello" becomes "/search"
+            
+            // Start parsing query string after the '?'
+            char *query_start = path + i + 1;  // Points to "q=hello&page=2"
+            
+            // Use strtok_r to split query string by '&' delimiter
+            char *token;
+            char *saveptr = NULL;
+            
+            // Loop through each parameter (e.g., "q=hello", "page=2")
+            token = strtok_r(query_start, "&", &saveptr);
+            while (token != NULL && query->param_count < MAX_HEADERS) {
+                // Find '=' to split key from value
+                char *equal_sign = strchr(token, '=');
+                if (equal_sign) {
+                    // Calculate lengths using pointer arithmetic
+                    size_t key_len = equal_sign - token;       // Length of "q"
+                    size_t value_len = strlen(equal_sign + 1); // Length of "hello"
+                    
+                    // Safety check: ensure fits in our buffers
+                    if (key_len < HEADER_LINE_SIZE && value_len < HEADER_LINE_SIZE) {
+                        // Copy key (before '=')
+                        strncpy(query->params[query->param_count].key, token, key_len);
+                        query->params[query->param_count].key[key_len] = '\0';
+                        
+                        // Copy value (after '=')
+                        strncpy(query->params[query->param_count].value, equal_sign + 1, value_len);
+                        query->params[query->param_count].value[value_len] = '\0';
+                        
+                        query->param_count++;
+                    }
+                }
+                
+                // Get next token
+                token = strtok_r(NULL, "&", &saveptr);
+            }
+            return query->param_count;
+        }
+    }
+    
+    // No '?' found - no query string present
+    return 0;
+}
+
+// Parse HTTP headers from request buffer
+// Returns the number of headers parsed
+int parse_http_headers(const char *request_buffer, HttpRequest *request) {
+    request->header_count = 0;
+    
+    // Find the end of the request line (first \r\n)
+    const char *header_start = strstr(request_buffer, "\r\n");
+    if (!header_start) {
+        return 0;  // No headers found
+    }
+    header_start += 2;  // Skip past the \r\n
+    
+    // Parse each header line until we hit \r\n\r\n (end of headers)
+    while (*header_start != '\0' && request->header_count < MAX_HEADERS) {
+        // Check for end of headers (empty line)
+        if (strncmp(header_start, "\r\n", 2) == 0) {
+            break;  // End of headers section
+        }
+        
+        // Find the colon separator using strchr()
+        const char *colon_pos = strchr(header_start, ':');
+        if (!colon_pos) {
+            break;  // Malformed header line
+        }
+        
+        // Find the end of this line using strstr()
+        const char *line_end = strstr(header_start, "\r\n");
+        if (!line_end) {
+            break;  // Malformed header line   
+        }
+        if (colon_pos > line_end) {
+            break;  // No colon on this line - the one found belongs to a later line
+        }
+        
+        // Calculate header name length
+        int name_len = colon_pos - header_start;
+        //Copy header name into request->headers[request->header_count].name
+        if(name_len < HEADER_LINE_SIZE){
+            strncpy(request->headers[request->header_count].name,header_start,name_len);
+            request->headers[request->header_count].name[name_len] = '\0';
+        }else{
+            //name too long, skip this header
+            break;
+        }        
+        // Find value start position (skip past colon and spaces)
+        const char *start_pos = colon_pos + 1;
+        while(*start_pos == ' ' || *start_pos == '\t'){
+            start_pos++;
+        }
+        const char *value_start = start_pos;
+        // Calculate header value length
+        int value_len = line_end - value_start;
+        // Copy header value into request->headers[request->header_count].value
+      
+        if(value_len < HEADER_LINE_SIZE){
+            strncpy(request->headers[request->header_count].value,value_start,value_len);
+            request->headers[request->header_count].value[value_len] = '\0';
+        }else{
+            //value too long, skip this header
+            break;
+        }
+        // Increment header counter
+
+        request->header_count++;
+        // Move to next line
+        header_start = line_end + 2;  // Move to the start of the next header line
+    }
+    
+    return request->header_count;
+}
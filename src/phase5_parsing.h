@@ -0,0 +1,42 @@
+#ifndef PHASE5_PARSING_H
+#define PHASE5_PARSING_H
+
+// Request parsing helpers of the phase 5 server, kept in their own
+// translation unit so they can be benchmarked (bench/phase5_bench.c) and
+// fuzzed (fuzz/phase5_fuzz.c) without the server around them
+
+#define MAX_HEADERS 32
+#define HEADER_LINE_SIZE 256
+
+// Structure to hold HTTP request headers
+typedef struct {
+    char name[HEADER_LINE_SIZE];
+    char value[HEADER_LINE_SIZE];
+} HttpHeader;
+
+typedef struct {
+    HttpHeader headers[MAX_HEADERS];
+    int header_count;
+} HttpRequest;
+
+typedef struct {
+    char key[HEADER_LINE_SIZE];
+    char value[HEADER_LINE_SIZE];
+} QueryParam;
+typedef struct {
+    QueryParam params[MAX_HEADERS];
+    int param_count;
+} QueryString;
+
+// Decode %XX escapes and '+' in place
+void url_decode(char *path);
+
+// Split "?key=value&..." off path (in place) into query
+// Returns the number of parameters parsed
+int parse_query_string(char *path, QueryString *query);
+
+// Parse the header lines that follow the request line
+// Returns the number of headers parsed
+int parse_http_headers(const char *request_buffer, HttpRequest *request);
+
+#endif
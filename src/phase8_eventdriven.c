@@ -0,0 +1,3672 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <poll.h>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
+#include <sys/inotify.h>
+#include <dirent.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <sched.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <stdarg.h>
+#include "http_parser.h"
+#include "http_scan.h"
+#include "mem_pool.h"
+#include "mime.h"
+#include "access_log.h"
+#include "metrics.h"
+#include "compress.h"
+#include "timer_wheel.h"
+#include "thread_pool.h"
+#include "uring.h"
+#include "asset_pack.h"
+#include "router.h"
+
+#define PORT 8080
+#define BUFFER_SIZE 4096
+#define REQUEST_BUFFER_SIZE 8192
+#define DOCUMENT_ROOT "./public"  // Mounted at / unless -D mounts something else there
+#define MAX_PATH_LENGTH 496      // Longest request target; DOCUMENT_ROOT + target fits a 512 byte path
+#define MAX_MOUNTS 16
+#define MAX_QUERY_PARAMS 32
+#define MAX_EVENTS 1024
+#define FILE_CACHE_BUCKETS 4096
+#define MAX_WATCHES 4096         // Room for the directories of a few hundred sites
+#define MAX_PIPELINE 16
+#define ARENA_SIZE 16384         // Per-connection arena for one response batch
+#define REQUEST_ARENA_RESERVE (MAX_PATH_LENGTH + MAX_QUERY_PARAMS * sizeof(HttpQueryParam) + 512)
+#define POOL_MAX_FREE 1024       // Idle buffers of each kind kept for reuse
+#define METRICS_BUFFER_SIZE (64 * 1024)
+#define MAX_CACHE_CONTROL_RULES 16
+#define MAX_CACHE_CONTROL_LENGTH 128
+#define TIMER_TICK_MS 100         // Resolution of connection deadlines
+#define URING_ENTRIES 1024        // Submission queue of the io_uring backend
+#define URING_BUFFERS 1024        // Provided receive buffers (power of two)
+#define URING_BUFFER_SIZE 4096
+#define SPLICE_PIPE_SIZE (1024 * 1024)  // Pipe capacity asked for: one splice per MB of body
+
+// Content-codings in order of preference when the client weighs them equally
+typedef enum {
+    ENCODING_BR,
+    ENCODING_GZIP,
+    ENCODING_COUNT
+} ContentEncoding;
+
+static const char *encoding_names[ENCODING_COUNT] = { "br", "gzip" };
+static const char *encoding_suffixes[ENCODING_COUNT] = { ".br", ".gz" };
+
+// Compressed representation of a cached file: a precompressed sibling
+// (file.br, file.gz) sent from its fd, or gzip made on the fly held in
+// memory, or either of them in the asset pack
+typedef struct {
+    int fd;                     // Sibling file, or -1 when data holds the body
+    off_t offset;               // Where the body starts in fd
+    char *data;
+    off_t length;
+    char etag[64];
+    char header[512];           // Like FileCacheEntry.header, with Content-Encoding
+    size_t header_len;
+} EncodedVariant;
+
+typedef enum {
+    GZIP_NONE,                  // Not attempted yet
+    GZIP_PENDING,               // Queued on the compressor thread
+    GZIP_DONE                   // Attached to the entry, or not worth it
+} GzipState;
+
+// One site's share of the file cache (see VirtualHost): its own LRU order
+// and limits, so a busy site only ever evicts its own files
+typedef struct CachePartition {
+    struct FileCacheEntry *lru_head;    // Most recently used
+    struct FileCacheEntry *lru_tail;    // Next to evict
+    int entry_count;
+    size_t memory_used;
+    int max_entries;
+    size_t max_memory;
+} CachePartition;
+
+// Cached open file: fd, metadata, content type and the response header
+// block that follows the status line and Date. Shared between connections
+// via refcount so an evicted entry outlives any response still using it
+typedef struct FileCacheEntry {
+    char path[512];
+    int fd;
+    off_t body_offset;          // Where the body starts in fd (non-zero inside the asset pack)
+    struct stat st;
+    const char *content_type;
+    char last_modified[32];     // HTTP date of st_mtime
+    char etag[48];              // Strong validator from inode, size and mtime
+    const char *cache_control;  // From the longest matching -C rule, or NULL
+    char header[512];
+    size_t header_len;
+    char *data;          // Whole body for small files, else NULL
+    size_t data_len;
+    int compressible;           // Worth a Content-Encoding (responses carry Vary)
+    GzipState gzip_state;       // On-the-fly gzip of this file
+    EncodedVariant *variants[ENCODING_COUNT];
+    size_t variant_memory;      // Bytes of variant bodies held in memory
+    int refcount;
+    int cached;          // Still linked into the cache
+    CachePartition *partition;  // Whose LRU list it is on
+    struct FileCacheEntry *hash_next;
+    struct FileCacheEntry *lru_prev;
+    struct FileCacheEntry *lru_next;
+} FileCacheEntry;
+
+typedef struct {
+    FileCacheEntry *buckets[FILE_CACHE_BUCKETS];   // Entries of every partition
+    int entry_count;            // Totals of all partitions
+    size_t memory_used;
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+    unsigned long invalidations;
+    unsigned long compressed_inline;        // gzip made on the event loop
+    unsigned long compressed_background;    // ... and on the compressor thread
+    unsigned long pool_loads;               // Misses opened on the I/O pool
+} FileCache;
+
+// Outcome of opening a file (see file_open)
+typedef struct {
+    int error;                  // errno, 0 on success
+    int fd;
+    struct stat st;
+    char *data;                 // Body of a small file (plain malloc), or NULL
+    int sibling_fds[ENCODING_COUNT];            // file.br / file.gz, or -1
+    struct stat sibling_st[ENCODING_COUNT];
+} FileOpen;
+
+// A cache miss being opened on the I/O pool for a waiting connection
+typedef struct {
+    PoolTask task;              // First member: the pool hands back the task
+    struct Connection *conn;    // Waiting for it; NULL once that connection closed
+    CachePartition *partition;  // Of the site it was requested from
+    unsigned long generation;   // file_cache.invalidations when submitted
+    char path[512];
+    FileOpen result;
+} FileLoad;
+
+// Complete pre-rendered error response (headers + body), refcounted so a
+// reload can replace it while connections are still sending the old one.
+// data holds the Connection: close variant followed by the keep-alive one.
+// The /metrics response is built the same way, as a one-off page
+typedef struct {
+    int refcount;
+    size_t close_len;
+    size_t keep_alive_len;
+    size_t body_len;            // For the access log
+    const char *content_type;
+    char data[];
+} ErrorPage;
+
+// One part of a multipart/byteranges body: boundary and part headers,
+// then bytes [start, end) of the file (the closing boundary has no bytes)
+typedef struct {
+    char *header;
+    size_t header_len;
+    off_t start;
+    off_t end;
+} RangePart;
+
+// Deadline a connection is currently under (see arm_read_timeout)
+typedef enum {
+    TIMEOUT_NONE,
+    TIMEOUT_HEADER,             // Rest of a request head (408 if any of it arrived)
+    TIMEOUT_BODY,               // Rest of a request body being skipped
+    TIMEOUT_IDLE,               // Next request on a kept-alive connection
+    TIMEOUT_REQUEST             // Whole request, from its first byte until the response is sent
+} TimeoutKind;
+
+static const char *timeout_names[] = { "none", "header", "body", "keep-alive idle", "request" };
+
+// Per-connection state machine
+// READING_HEADERS -> SENDING_HEADERS -> SENDING_BODY -> CLOSING,
+// or back to READING_HEADERS when the connection is kept alive.
+// WAITING_FILE parks a connection between reading and sending while the
+// I/O pool opens the file its request needs
+typedef enum {
+    CONN_READING_HEADERS,
+    CONN_WAITING_FILE,
+    CONN_SENDING_HEADERS,
+    CONN_SENDING_BODY,
+    CONN_CLOSING
+} ConnState;
+
+typedef struct Connection {
+    int fd;
+    ConnState state;
+    char client_ip[INET_ADDRSTRLEN];
+    int client_port;
+    int keep_alive;             // Keep the connection open after this batch
+    int requests_served;
+    int peer_closed;            // Read returned 0 - finish answering, then close
+    size_t discard_remaining;   // Request body bytes still to skip
+
+    // Request bytes received so far (null terminated); the current
+    // request always starts at in_buf[0] and the parser keeps slices into it.
+    // in_buf is a REQUEST_BUFFER_SIZE buffer from receive_pool, held only
+    // while there are unprocessed bytes
+    char *in_buf;
+    size_t in_len;
+    HttpParser parser;
+
+    // Batch of responses to pipelined requests, sent with one sendmsg().
+    // Each response is its status line (+ Date, Connection) from the arena,
+    // the cached header block and small in-memory body, or an error page.
+    // iov_index and the iov entries advance as sendmsg() makes progress.
+    // The arena's memory comes from arena_pool when the first response is
+    // staged and goes back when the batch has been sent
+    Arena arena;
+    struct iovec iov[MAX_PIPELINE * 3];
+    int iov_count;
+    int iov_index;
+    FileCacheEntry *cache_entries[MAX_PIPELINE];
+    ErrorPage *error_pages[MAX_PIPELINE];
+    int response_count;
+    struct VirtualHost *vhost;  // Site of the last request (error pages before one is known)
+
+    // Large body of the last response in the batch, sent straight from the
+    // cached fd with sendfile(); file_offset advances up to file_end
+    int file_fd;
+    off_t file_offset;
+    off_t file_end;
+
+    // Remaining parts of a multipart/byteranges response (in the arena),
+    // each sent as its header iovec followed by a sendfile() range
+    RangePart *range_parts;
+    int range_part_count;
+    int range_part_index;
+
+    // Stage timestamps (metrics_now() nanoseconds, 0 = not reached yet)
+    uint64_t accepted_ns;       // Until the first byte arrives
+    uint64_t last_read_ns;
+    uint64_t request_start_ns;  // First byte of the request being parsed
+    uint64_t batch_start_ns;    // First byte of the batch's first request
+    uint64_t batch_parsed_ns;   // Its head parsed
+    uint64_t first_write_ns;    // First byte of the batch written
+
+    // Deadline of the current stage, on the timer wheel
+    Timer timer;
+    TimeoutKind timeout_kind;
+
+    // Cache miss the current request waits for on the I/O pool; once it is
+    // done the request runs again and takes loaded_entry (or loaded_errno)
+    // instead of looking the file up
+    FileLoad *file_load;
+    int file_loaded;
+    FileCacheEntry *loaded_entry;
+    int loaded_errno;
+
+    // io_uring backend: operations in flight (a closed connection's memory
+    // is released once they have all completed), the message its sendmsg
+    // reads, and the pipe large bodies are spliced through, holding
+    // pipe_bytes that have not reached the socket yet (pipe_size at most)
+    int recv_pending;
+    int send_pending;
+    struct msghdr msg;
+    int pipe_fds[2];
+    size_t pipe_size;
+    size_t pipe_bytes;
+} Connection;
+
+// Cache-Control value for files whose path (below the document root) starts with prefix
+typedef struct {
+    const char *prefix;
+    const char *value;
+} CacheControlRule;
+
+// A directory served below a URL prefix (-D /prefix/=dir): routed as "/prefix/*path"
+typedef struct {
+    char pattern[256];
+    size_t prefix_len;          // Of the "/prefix/" part of pattern
+    char root[256];             // "./dir" as the asset pack stores it, no trailing '/'
+} StaticMount;
+
+// Runtime settings from the command line
+typedef struct {
+    int port;
+    int backlog;
+    int workers;   // 0 = single process, no master
+    int pin_cpus;
+    int cache_entries;          // Max open files cached (0 = no cache)
+    size_t cache_memory;        // Max bytes of file bodies held in memory
+    off_t cache_small_file;     // Files up to this size are held in memory
+    int keepalive_timeout;      // Seconds a connection may wait for a request (0 = no keep-alive)
+    int max_requests;           // Requests per connection before closing
+    int header_timeout;         // Seconds to receive a request head (408 beyond)
+    int body_timeout;           // Seconds to receive a request body
+    int request_timeout;        // Seconds from a request's first byte to its response sent (0 = none)
+    HttpParserLimits limits;    // Request size limits (400/413/414/431)
+    const char *mime_types;     // MIME types file overriding the built-in table
+    const char *access_log;     // Access log file ("-" = stdout, "off" = none)
+    int access_log_format;      // AccessLogFormat
+    int verbosity;              // Debug output on stdout (0 = none)
+    const char *metrics_path;   // Reserved path for Prometheus metrics (NULL = none)
+    off_t compress_inline;      // gzip files up to this size on the event loop
+    off_t compress_max;         // ... larger ones up to this on the compressor thread (0 = never)
+    int io_threads;             // Pool threads opening uncached files (0 = on the event loop)
+    int io_uring;               // Use the io_uring backend where available (else epoll)
+    const char *asset_pack;     // Serve everything from this pack instead of the file system
+    CacheControlRule cache_control[MAX_CACHE_CONTROL_RULES];
+    int cache_control_count;
+    const char *health_path;    // Path of the liveness endpoint (NULL = none)
+    StaticMount mounts[MAX_MOUNTS];
+    int mount_count;
+} ServerConfig;
+
+static ServerConfig config = {
+    PORT, SOMAXCONN, 0, 0, 1024, 64 * 1024 * 1024, 16 * 1024, 5, 100, 10, 30, 300,
+    { MAX_PATH_LENGTH + 32, REQUEST_BUFFER_SIZE - 1, HTTP_MAX_HEADERS, 1024 * 1024 },
+    NULL, "-", ACCESS_LOG_COMMON, 0, "/metrics", 64 * 1024, 16 * 1024 * 1024, 0, 0, NULL, { { NULL, NULL } }, 0,
+    NULL, { { "", 0, "" } }, 0
+};
+
+static FileCache file_cache;
+
+// Asset pack (-P), mapped before the workers fork, and the cache entry of
+// each packed asset that has been requested, indexed like its record
+static AssetPack asset_pack = { -1, NULL, 0, NULL, NULL, 0, 0 };
+static FileCacheEntry **asset_entries;
+static unsigned long asset_hits;
+static unsigned long asset_misses;
+
+// What a route leads to: a handler that builds the response, or a static mount
+typedef void (*RouteHandler)(Connection *conn, const RouteMatch *match, int is_head);
+typedef struct {
+    RouteHandler handler;       // NULL for a static mount
+    const StaticMount *mount;
+} Route;
+
+// URL dispatch (see build_router), built before the workers fork
+static Router router;
+static Route handler_routes[2];
+static Route mount_routes[MAX_MOUNTS];
+
+// Recycled memory for the request path (see mem_pool.h)
+static BufferPool connection_pool;
+static BufferPool receive_pool;
+static BufferPool arena_pool;
+static size_t arena_high_water;  // Most arena bytes one batch has needed
+
+// Statuses with a pre-rendered error page (./errors/<code>.html or the fallback)
+static const struct {
+    int code;
+    const char *message;
+} error_statuses[] = {
+    { 400, "Bad Request" },
+    { 403, "Forbidden" },
+    { 404, "Not Found" },
+    { 405, "Method Not Allowed" },
+    { 408, "Request Timeout" },
+    { 413, "Content Too Large" },
+    { 414, "URI Too Long" },
+    { 431, "Request Header Fields Too Large" },
+    { 500, "Internal Server Error" },
+    { 501, "Not Implemented" },
+};
+#define ERROR_STATUS_COUNT (sizeof(error_statuses) / sizeof(error_statuses[0]))
+
+// A site: the default one (the routes and mounts, ./errors) or a
+// name-based virtual host (-V host=dir), serving dir/public at / with the
+// pages in dir/errors (the default site's where it has none). Every site
+// has its own cache partition
+typedef struct VirtualHost {
+    char name[256];             // Normalized (see vhost_for); a wildcard "*.example.com" as ".example.com"
+    StaticMount mount;          // dir/public at / (unused by the default site)
+    char errors[512];           // Error pages directory
+    ErrorPage *error_pages[ERROR_STATUS_COUNT];
+    CachePartition cache;
+} VirtualHost;
+
+static VirtualHost default_host = { "", { "", 0, "" }, "./errors", { NULL }, { NULL, NULL, 0, 0, 0, 0 } };
+static VirtualHost *vhosts;
+static int vhost_count;
+static int vhost_capacity;
+static VirtualHost **vhost_table;   // Open addressing on the name, vhost_mask + 1 slots
+static size_t vhost_mask;
+
+// inotify watch descriptor -> directory it watches
+typedef struct {
+    int wd;
+    char dir[512];
+} WatchedDir;
+
+static int inotify_fd = -1;
+static WatchedDir watched_dirs[MAX_WATCHES];
+static int watch_count = 0;
+
+// epoll data.ptr markers for the non-connection fds
+static int listener_marker;
+static int inotify_marker;
+static int compress_marker;
+static int compress_fd = -1;
+static int io_pool_marker;
+static int io_pool_fd = -1;     // Completions of the I/O pool, -1 without one
+static Uring uring;
+static int uring_active;        // Connections are driven by io_uring completions, not epoll
+static volatile sig_atomic_t stats_requested = 0;
+static volatile sig_atomic_t reload_requested = 0;
+
+static int active_connections = 0;
+static TimerWheel timers;
+static uint64_t current_tick;   // TIMER_TICK_MS ticks of the monotonic clock, once per loop iteration
+
+// Date header and log timestamp, rendered once per second instead of
+// calling gmtime()/localtime() + strftime() for every response
+typedef struct {
+    time_t second;              // Wall-clock second the strings were rendered for
+    char http_date[32];         // RFC 1123, always GMT
+    char log_timestamp[32];     // Local time for log lines
+} ServerClock;
+
+static ServerClock server_clock = { -1, "", "" };
+
+// Called once per event loop wakeup; the coarse clock is read without a syscall
+void server_clock_update(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+    if (ts.tv_sec == server_clock.second) {
+        return;
+    }
+    server_clock.second = ts.tv_sec;
+
+    struct tm tm;
+    gmtime_r(&ts.tv_sec, &tm);
+    strftime(server_clock.http_date, sizeof(server_clock.http_date), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    localtime_r(&ts.tv_sec, &tm);
+    strftime(server_clock.log_timestamp, sizeof(server_clock.log_timestamp), "%Y-%m-%d %H:%M:%S", &tm);
+}
+
+// Diagnostic output on stdout, off unless -v is given (once per level)
+static void debug_log(int level, const char *format, ...) __attribute__((format(printf, 2, 3)));
+static void debug_log(int level, const char *format, ...) {
+    if (config.verbosity < level) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+}
+
+// Raise the open file limit so we can hold tens of thousands of sockets
+void raise_fd_limit(void) {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        if (setrlimit(RLIMIT_NOFILE, &limit) < 0) {
+            perror("Raise fd limit failed");
+        }
+    }
+}
+
+// FNV-1a hash of a resolved file path
+static unsigned long hash_path(const char *path) {
+    unsigned long hash = 2166136261UL;
+    while (*path) {
+        hash ^= (unsigned char)*path++;
+        hash *= 16777619UL;
+    }
+    return hash;
+}
+
+// Unlink an entry from its hash chain and the LRU list
+static void file_cache_unlink(FileCacheEntry *entry) {
+    FileCacheEntry **link = &file_cache.buckets[hash_path(entry->path) % FILE_CACHE_BUCKETS];
+    while (*link && *link != entry) {
+        link = &(*link)->hash_next;
+    }
+    if (*link) {
+        *link = entry->hash_next;
+    }
+    CachePartition *partition = entry->partition;
+    if (entry->lru_prev) {
+        entry->lru_prev->lru_next = entry->lru_next;
+    } else {
+        partition->lru_head = entry->lru_next;
+    }
+    if (entry->lru_next) {
+        entry->lru_next->lru_prev = entry->lru_prev;
+    } else {
+        partition->lru_tail = entry->lru_prev;
+    }
+    entry->hash_next = entry->lru_prev = entry->lru_next = NULL;
+    entry->cached = 0;
+    partition->entry_count--;
+    partition->memory_used -= entry->data_len + entry->variant_memory;
+    file_cache.entry_count--;
+    file_cache.memory_used -= entry->data_len + entry->variant_memory;
+}
+
+static void file_cache_free(FileCacheEntry *entry) {
+    for (int i = 0; i < ENCODING_COUNT; i++) {
+        if (entry->variants[i]) {
+            if (entry->variants[i]->fd >= 0) {
+                close(entry->variants[i]->fd);
+            }
+            counted_free(entry->variants[i]->data);
+            counted_free(entry->variants[i]);
+        }
+    }
+    close(entry->fd);
+    counted_free(entry->data);
+    counted_free(entry);
+}
+
+// Drop a reference taken by file_cache_lookup() or file_cache_insert()
+// Evicted entries stay alive until the last connection using them lets go
+void file_cache_release(FileCacheEntry *entry) {
+    if (--entry->refcount == 0 && !entry->cached) {
+        file_cache_free(entry);
+    }
+}
+
+// Remove an entry from the cache (it is freed once unreferenced)
+static void file_cache_remove(FileCacheEntry *entry) {
+    file_cache_unlink(entry);
+    entry->refcount++;
+    file_cache_release(entry);
+}
+
+// Evict a partition's least recently used entries until it is within its limits
+static void file_cache_evict(CachePartition *partition) {
+    while (partition->lru_tail &&
+           (partition->entry_count > partition->max_entries ||
+            partition->memory_used > partition->max_memory)) {
+        file_cache_remove(partition->lru_tail);
+        file_cache.evictions++;
+    }
+}
+
+// Strong entity-tag: any change of inode, size or mtime (to the nanosecond) changes it
+static void format_etag(char *buf, size_t size, const struct stat *st) {
+    snprintf(buf, size, "\"%lx-%llx-%llx\"", (unsigned long)st->st_ino, (unsigned long long)st->st_size,
+             (unsigned long long)st->st_mtim.tv_sec * 1000000000ULL + st->st_mtim.tv_nsec);
+}
+
+static void format_http_date(char *buf, size_t size, time_t time) {
+    struct tm tm;
+    gmtime_r(&time, &tm);
+    strftime(buf, size, "%a, %d %b %Y %H:%M:%S GMT", &tm);
+}
+
+// Mount (or virtual host root) serving a file path - the one with the
+// longest root; of a directory mounted twice, the first - or NULL
+static const StaticMount *mount_for(const char *file_path) {
+    const StaticMount *mount = NULL;
+    size_t longest = 0;
+    for (int i = 0; i < config.mount_count + vhost_count; i++) {
+        const StaticMount *candidate = i < config.mount_count ? &config.mounts[i] : &vhosts[i - config.mount_count].mount;
+        size_t len = strlen(candidate->root);
+        if (len > longest && strncmp(file_path, candidate->root, len) == 0 && file_path[len] == '/') {
+            mount = candidate;
+            longest = len;
+        }
+    }
+    return mount;
+}
+
+// Cache-Control of the longest -C prefix matching the URL a file is served at, or NULL
+static const char *cache_control_for(const char *file_path) {
+    const StaticMount *mount = mount_for(file_path);
+    if (!mount) {
+        return NULL;
+    }
+    char path[1024];
+    snprintf(path, sizeof(path), "%.*s%s", (int)mount->prefix_len, mount->pattern,
+             file_path + strlen(mount->root) + 1);
+    const char *value = NULL;
+    size_t longest = 0;
+    for (int i = 0; i < config.cache_control_count; i++) {
+        size_t len = strlen(config.cache_control[i].prefix);
+        if (len >= longest && strncmp(path, config.cache_control[i].prefix, len) == 0) {
+            value = config.cache_control[i].value;
+            longest = len;
+        }
+    }
+    return value;
+}
+
+// Build a variant's header block; its ETag is the entry's with the coding appended
+static void variant_init_header(FileCacheEntry *entry, EncodedVariant *variant, ContentEncoding encoding) {
+    asset_format_variant_etag(variant->etag, sizeof(variant->etag), entry->etag, encoding_names[encoding]);
+    int len = asset_format_header(variant->header, sizeof(variant->header), entry->content_type,
+                                  encoding_names[encoding], variant->length, entry->last_modified,
+                                  variant->etag, 1, entry->cache_control);
+    variant->header_len = len > 0 ? (size_t)len : 0;
+}
+
+// Open a file: the blocking system calls of a cache miss, which may run on
+// an I/O pool thread (see start_file_load), so nothing here touches the
+// cache or the counted allocator. Small bodies are read with plain malloc
+static void file_open(const char *file_path, FileOpen *result) {
+    memset(result, 0, sizeof(*result));
+    for (int i = 0; i < ENCODING_COUNT; i++) {
+        result->sibling_fds[i] = -1;
+    }
+    // O_NONBLOCK so a FIFO under the root can't stall the event loop in open()
+    result->fd = open(file_path, O_RDONLY | O_NONBLOCK);
+    if (result->fd < 0) {
+        result->error = errno;
+        return;
+    }
+    if (fstat(result->fd, &result->st) < 0) {
+        result->error = errno;
+    } else if (!S_ISREG(result->st.st_mode)) {
+        // FIFOs, sockets and devices are never served
+        result->error = S_ISDIR(result->st.st_mode) ? EISDIR : EACCES;
+    }
+    if (result->error) {
+        close(result->fd);
+        result->fd = -1;
+        return;
+    }
+
+    // file.br / file.gz next to a compressible file; a sibling older than
+    // the file itself is stale and ignored
+    if (mime_is_compressible(mime_type_for_path(file_path)) && result->st.st_size >= COMPRESS_MIN_SIZE) {
+        for (int i = 0; i < ENCODING_COUNT; i++) {
+            char sibling_path[512 + 4];
+            snprintf(sibling_path, sizeof(sibling_path), "%s%s", file_path, encoding_suffixes[i]);
+            int fd = open(sibling_path, O_RDONLY | O_NONBLOCK);
+            if (fd < 0) {
+                continue;
+            }
+            if (fstat(fd, &result->sibling_st[i]) < 0 || !S_ISREG(result->sibling_st[i].st_mode) ||
+                result->sibling_st[i].st_mtime < result->st.st_mtime) {
+                close(fd);
+                continue;
+            }
+            result->sibling_fds[i] = fd;
+        }
+    }
+
+    // Small files are kept in memory so a hit is a single writev()
+    off_t size = result->st.st_size;
+    if (size > 0 && size <= config.cache_small_file) {
+        result->data = malloc(size);
+        if (result->data && read(result->fd, result->data, size) != size) {
+            free(result->data);
+            result->data = NULL;  // Fall back to sendfile
+        }
+    }
+}
+
+// Give back whatever of an opened file was not taken into an entry
+static void file_open_discard(FileOpen *result) {
+    if (result->fd >= 0) {
+        close(result->fd);
+    }
+    for (int i = 0; i < ENCODING_COUNT; i++) {
+        if (result->sibling_fds[i] >= 0) {
+            close(result->sibling_fds[i]);
+        }
+    }
+    free(result->data);
+}
+
+// Build the cache entry of an opened file: content type, validators, header
+// block, siblings and in-memory body. Returns NULL with errno set
+static FileCacheEntry *file_cache_build(const char *file_path, FileOpen *result) {
+    if (result->error) {
+        errno = result->error;
+        return NULL;
+    }
+    FileCacheEntry *entry = counted_calloc(1, sizeof(FileCacheEntry));
+    if (!entry) {
+        file_open_discard(result);
+        errno = ENOMEM;
+        return NULL;
+    }
+    entry->fd = result->fd;
+    entry->st = result->st;
+    snprintf(entry->path, sizeof(entry->path), "%s", file_path);
+    entry->content_type = mime_type_for_path(file_path);
+
+    format_http_date(entry->last_modified, sizeof(entry->last_modified), entry->st.st_mtime);
+    format_etag(entry->etag, sizeof(entry->etag), &entry->st);
+    entry->cache_control = cache_control_for(file_path);
+    entry->compressible = mime_is_compressible(entry->content_type) && entry->st.st_size >= COMPRESS_MIN_SIZE;
+
+    // Everything after the status line, Date and Connection is the same for every hit
+    int header_len = asset_format_header(entry->header, sizeof(entry->header), entry->content_type, NULL,
+                                         entry->st.st_size, entry->last_modified, entry->etag,
+                                         entry->compressible, entry->cache_control);
+    entry->header_len = header_len > 0 ? (size_t)header_len : 0;
+    for (int i = 0; i < ENCODING_COUNT; i++) {
+        int fd = result->sibling_fds[i];
+        EncodedVariant *variant = fd >= 0 ? counted_calloc(1, sizeof(EncodedVariant)) : NULL;
+        if (!variant) {
+            if (fd >= 0) {
+                close(fd);
+            }
+            continue;
+        }
+        variant->fd = fd;
+        variant->length = result->sibling_st[i].st_size;
+        variant_init_header(entry, variant, i);
+        entry->variants[i] = variant;
+    }
+    if (result->data) {
+        alloc_counters.mallocs++;  // Read by file_open()
+        entry->data = result->data;
+        entry->data_len = entry->st.st_size;
+    }
+    return entry;
+}
+
+// Open a file and build its cache entry on the event loop
+static FileCacheEntry *file_cache_load(const char *file_path) {
+    FileOpen result;
+    file_open(file_path, &result);
+    return file_cache_build(file_path, &result);
+}
+
+// Look up a resolved path without loading it
+// Returns a referenced entry (release with file_cache_release) or NULL if not cached
+FileCacheEntry *file_cache_lookup(const char *file_path) {
+    unsigned long bucket = hash_path(file_path) % FILE_CACHE_BUCKETS;
+    for (FileCacheEntry *entry = file_cache.buckets[bucket]; entry; entry = entry->hash_next) {
+        if (strcmp(entry->path, file_path) != 0) {
+            continue;
+        }
+        file_cache.hits++;
+        // Move to the front of its partition's LRU list (a directory two
+        // sites serve is cached once, in the partition that loaded it)
+        CachePartition *partition = entry->partition;
+        if (entry != partition->lru_head) {
+            entry->lru_prev->lru_next = entry->lru_next;
+            if (entry->lru_next) {
+                entry->lru_next->lru_prev = entry->lru_prev;
+            } else {
+                partition->lru_tail = entry->lru_prev;
+            }
+            entry->lru_prev = NULL;
+            entry->lru_next = partition->lru_head;
+            partition->lru_head->lru_prev = entry;
+            partition->lru_head = entry;
+        }
+        entry->refcount++;
+        return entry;
+    }
+    return NULL;
+}
+
+// Link a freshly built entry into a partition of the cache, replacing any
+// entry for the same path (a concurrent pool load may have got there first)
+// Returns the entry with the caller's reference
+static FileCacheEntry *file_cache_insert(CachePartition *partition, FileCacheEntry *entry) {
+    entry->refcount = 1;
+    if (config.cache_entries == 0) {
+        return entry;  // Cache disabled - freed on release
+    }
+    unsigned long bucket = hash_path(entry->path) % FILE_CACHE_BUCKETS;
+    for (FileCacheEntry *old = file_cache.buckets[bucket]; old; old = old->hash_next) {
+        if (strcmp(old->path, entry->path) == 0) {
+            file_cache_remove(old);
+            break;
+        }
+    }
+    entry->cached = 1;
+    entry->partition = partition;
+    entry->hash_next = file_cache.buckets[bucket];
+    file_cache.buckets[bucket] = entry;
+    entry->lru_next = partition->lru_head;
+    if (partition->lru_head) {
+        partition->lru_head->lru_prev = entry;
+    } else {
+        partition->lru_tail = entry;
+    }
+    partition->lru_head = entry;
+    partition->entry_count++;
+    partition->memory_used += entry->data_len;
+    file_cache.entry_count++;
+    file_cache.memory_used += entry->data_len;
+    file_cache_evict(partition);
+    return entry;
+}
+
+// Load a path file_cache_lookup() missed, right here on the event loop
+// Returns a referenced entry (release with file_cache_release) or NULL with errno set
+static FileCacheEntry *file_cache_load_miss(CachePartition *partition, const char *file_path) {
+    file_cache.misses++;
+    FileCacheEntry *entry = file_cache_load(file_path);
+    return entry ? file_cache_insert(partition, entry) : NULL;
+}
+
+// Runs on an I/O pool thread
+static void file_load_run(PoolTask *task) {
+    FileLoad *load = (FileLoad *)task;
+    file_open(load->path, &load->result);
+}
+
+// Open a cache miss on the I/O pool; the connection waits in
+// CONN_WAITING_FILE until file_load_done() runs its request again
+// Returns -1 (load it on the event loop instead) without a pool or when its queues are full
+static int start_file_load(Connection *conn, CachePartition *partition, const char *file_path) {
+    if (io_pool_fd < 0) {
+        return -1;
+    }
+    FileLoad *load = counted_malloc(sizeof(FileLoad));
+    if (!load) {
+        return -1;
+    }
+    load->task.run = file_load_run;
+    load->conn = conn;
+    load->partition = partition;
+    load->generation = file_cache.invalidations;
+    snprintf(load->path, sizeof(load->path), "%s", file_path);
+    if (thread_pool_submit(&load->task) < 0) {
+        counted_free(load);
+        return -1;
+    }
+    file_cache.misses++;
+    file_cache.pool_loads++;
+    conn->file_load = load;
+    return 0;
+}
+
+// Give an entry the gzip made on the fly for it (a malloc'd buffer from
+// compress.c, which the entry now owns) and charge it to the cache memory
+static void file_cache_attach_gzip(FileCacheEntry *entry, char *data, size_t len) {
+    EncodedVariant *variant = counted_calloc(1, sizeof(EncodedVariant));
+    if (!variant) {
+        free(data);
+        return;
+    }
+    alloc_counters.mallocs++;  // data, allocated by compress.c
+    variant->fd = -1;
+    variant->data = data;
+    variant->length = len;
+    variant_init_header(entry, variant, ENCODING_GZIP);
+    entry->variants[ENCODING_GZIP] = variant;
+    entry->variant_memory += len;
+    entry->partition->memory_used += len;
+    file_cache.memory_used += len;
+    file_cache_evict(entry->partition);
+}
+
+// gzip a cached file once: small files right away on the event loop,
+// larger ones on the compressor thread while this response goes out as is.
+// Only cached entries are compressed, so the work is never repeated
+static void file_cache_compress(FileCacheEntry *entry) {
+    off_t size = entry->st.st_size;
+    if (!entry->cached || entry->gzip_state != GZIP_NONE || size > config.compress_max) {
+        return;
+    }
+    // With an I/O pool, a body that is not in memory is not read on the event loop either
+    if (size > config.compress_inline || (!entry->data && io_pool_fd >= 0)) {
+        entry->refcount++;  // Held by the job until compress_done()
+        if (compress_submit(entry, entry->fd, size) == 0) {
+            entry->gzip_state = GZIP_PENDING;
+        } else {
+            entry->refcount--;  // Queue full - try again on a later request
+        }
+        return;
+    }
+
+    entry->gzip_state = GZIP_DONE;
+    char *contents = entry->data;
+    if (!contents) {
+        contents = counted_malloc(size);
+        if (!contents || pread(entry->fd, contents, size, 0) != size) {
+            counted_free(contents);
+            return;
+        }
+    }
+    char *compressed;
+    size_t len;
+    if (gzip_compress(contents, size, &compressed, &len) == 0) {
+        file_cache_attach_gzip(entry, compressed, len);
+        file_cache.compressed_inline++;
+    }
+    if (contents != entry->data) {
+        counted_free(contents);
+    }
+}
+
+// A compressor thread job finished (see compress_collect)
+static void compress_done(void *owner, char *data, size_t len) {
+    FileCacheEntry *entry = owner;
+    entry->gzip_state = GZIP_DONE;
+    if (data && entry->cached) {
+        file_cache_attach_gzip(entry, data, len);
+        file_cache.compressed_background++;
+    } else {
+        free(data);  // Failed, no smaller, or the file changed meanwhile
+    }
+    file_cache_release(entry);
+}
+
+// Drop the entry for one path, if cached (no hit/miss accounting)
+void file_cache_invalidate(const char *file_path) {
+    FileCacheEntry *entry = file_cache.buckets[hash_path(file_path) % FILE_CACHE_BUCKETS];
+    while (entry && strcmp(entry->path, file_path) != 0) {
+        entry = entry->hash_next;
+    }
+    if (entry) {
+        file_cache_remove(entry);
+        file_cache.invalidations++;
+    }
+}
+
+// Drop every entry under a directory (NULL = everything), in any partition
+void file_cache_invalidate_prefix(const char *dir) {
+    size_t dir_len = dir ? strlen(dir) : 0;
+    for (int bucket = 0; bucket < FILE_CACHE_BUCKETS && file_cache.entry_count > 0; bucket++) {
+        FileCacheEntry *entry = file_cache.buckets[bucket];
+        while (entry) {
+            FileCacheEntry *next = entry->hash_next;
+            if (!dir || (strncmp(entry->path, dir, dir_len) == 0 && entry->path[dir_len] == '/')) {
+                file_cache_remove(entry);
+                file_cache.invalidations++;
+            }
+            entry = next;
+        }
+    }
+}
+
+// Cache entry for a packed asset, made without a system call: the headers
+// were rendered by pack_gen, small bodies are read straight from the
+// mapping and larger ones sent from the pack's fd at their offset
+static FileCacheEntry *asset_entry_build(const AssetRecord *record) {
+    FileCacheEntry *entry = counted_calloc(1, sizeof(FileCacheEntry));
+    if (!entry) {
+        return NULL;
+    }
+    snprintf(entry->path, sizeof(entry->path), "%s", asset_pack_bytes(&asset_pack, record->path));
+    entry->fd = asset_pack.fd;
+    entry->body_offset = record->body.offset;
+    entry->st.st_mode = S_IFREG | 0444;
+    entry->st.st_size = record->body.length;
+    entry->st.st_mtime = record->mtime;
+    entry->content_type = asset_pack_bytes(&asset_pack, record->content_type);
+    snprintf(entry->last_modified, sizeof(entry->last_modified), "%s", record->last_modified);
+    snprintf(entry->etag, sizeof(entry->etag), "%s", record->etag);
+    entry->cache_control = cache_control_for(entry->path);
+    entry->compressible = record->compressible;
+    entry->gzip_state = GZIP_DONE;  // pack_gen made whatever gzip there is
+    if (record->body.length > 0 && (off_t)record->body.length <= config.cache_small_file) {
+        entry->data = (char *)asset_pack_bytes(&asset_pack, record->body);
+        entry->data_len = record->body.length;
+    }
+    if (entry->cache_control) {
+        int len = asset_format_header(entry->header, sizeof(entry->header), entry->content_type, NULL,
+                                      entry->st.st_size, entry->last_modified, entry->etag,
+                                      entry->compressible, entry->cache_control);
+        entry->header_len = len > 0 ? (size_t)len : 0;
+    } else {
+        memcpy(entry->header, asset_pack_bytes(&asset_pack, record->header), record->header.length);
+        entry->header_len = record->header.length;
+    }
+
+    for (int i = 0; i < ENCODING_COUNT; i++) {
+        const AssetVariant *packed = &record->variants[i];
+        EncodedVariant *variant = packed->body.length > 0 ? counted_calloc(1, sizeof(EncodedVariant)) : NULL;
+        if (!variant) {
+            continue;
+        }
+        variant->fd = asset_pack.fd;
+        variant->offset = packed->body.offset;
+        variant->length = packed->body.length;
+        if ((off_t)packed->body.length <= config.cache_small_file) {
+            variant->data = (char *)asset_pack_bytes(&asset_pack, packed->body);
+        }
+        if (entry->cache_control) {
+            variant_init_header(entry, variant, i);
+        } else {
+            snprintf(variant->etag, sizeof(variant->etag), "%s", packed->etag);
+            memcpy(variant->header, asset_pack_bytes(&asset_pack, packed->header), packed->header.length);
+            variant->header_len = packed->header.length;
+        }
+        entry->variants[i] = variant;
+    }
+    return entry;
+}
+
+// Look a resolved path up in the asset pack; a path it lacks does not
+// exist. Entries are built on first use and never freed: asset_entries
+// keeps a reference, so the shared pack fd is never closed by a release
+// Returns a referenced entry (release with file_cache_release) or NULL with errno set
+static FileCacheEntry *asset_pack_acquire(const char *file_path) {
+    const AssetRecord *record = asset_pack_find(&asset_pack, file_path);
+    if (!record) {
+        asset_misses++;
+        errno = ENOENT;
+        return NULL;
+    }
+    FileCacheEntry **slot = &asset_entries[record - asset_pack.records];
+    if (!*slot) {
+        *slot = asset_entry_build(record);
+        if (!*slot) {
+            errno = ENOMEM;
+            return NULL;
+        }
+        (*slot)->refcount = 1;
+    }
+    asset_hits++;
+    (*slot)->refcount++;
+    return *slot;
+}
+
+void print_cache_stats(void) {
+    printf("File cache (pid %d): %d entries, %zu bytes in memory, %lu hits, %lu misses, %lu evictions, %lu invalidations\n",
+           getpid(), file_cache.entry_count, file_cache.memory_used,
+           file_cache.hits, file_cache.misses, file_cache.evictions, file_cache.invalidations);
+    printf("Compression (pid %d): %lu gzip on the event loop, %lu on the compressor thread\n",
+           getpid(), file_cache.compressed_inline, file_cache.compressed_background);
+    if (io_pool_fd >= 0) {
+        printf("I/O pool (pid %d): %lu misses opened, %lu tasks run, %lu stolen\n",
+               getpid(), file_cache.pool_loads, thread_pool_completed(), thread_pool_stolen());
+    }
+    if (asset_pack.base) {
+        unsigned long built = 0;
+        for (uint32_t i = 0; i < asset_pack.asset_count; i++) {
+            built += asset_entries[i] != NULL;
+        }
+        printf("Asset pack (pid %d): %u assets, %lu requested so far, %lu hits, %lu not in the pack\n",
+               getpid(), asset_pack.asset_count, built, asset_hits, asset_misses);
+    }
+}
+
+// Heap allocations should stop growing once the pools have warmed up
+void print_memory_stats(void) {
+    printf("Memory (pid %d): %lu mallocs, %lu frees, arena high water %zu of %d bytes\n",
+           getpid(), alloc_counters.mallocs, alloc_counters.frees, arena_high_water, ARENA_SIZE);
+    const BufferPool *pools[] = { &connection_pool, &receive_pool, &arena_pool };
+    const char *names[] = { "connections", "receive buffers", "arenas" };
+    for (int i = 0; i < 3; i++) {
+        printf("  %-16s %zu in use, %zu free, %lu reused\n",
+               names[i], pools[i]->in_use, pools[i]->free_count, pools[i]->reuses);
+    }
+}
+
+// Read <errors>/<code>.html (from the asset pack when there is one, or use
+// the built-in fallback) and render the complete response - status line,
+// headers and body - into one buffer. Unless builtin is set, a missing
+// page is NULL with errno ENOENT
+ErrorPage *render_error_page(const char *errors, int status_code, const char *status_message, int builtin) {
+    char error_file_path[600];
+    snprintf(error_file_path, sizeof(error_file_path), "%s/%d.html", errors, status_code);
+
+    const char *fallback = "<html><body><h1>Error</h1><p>An error occurred.</p></body></html>";
+    const char *content_type = "text/html";
+    const char *body = fallback;
+    char *error_html = NULL;
+    size_t body_len = strlen(fallback);
+
+    struct stat file_stat;
+    const AssetRecord *record = asset_pack.base ? asset_pack_find(&asset_pack, error_file_path) : NULL;
+    int file_fd = asset_pack.base ? -1 : open(error_file_path, O_RDONLY);
+    if (!record && file_fd < 0 && !builtin) {
+        errno = ENOENT;
+        return NULL;
+    }
+    if (record) {
+        body = asset_pack_bytes(&asset_pack, record->body);
+        body_len = record->body.length;
+        content_type = "text/html; charset=UTF-8";
+    } else if (file_fd >= 0) {
+        if (fstat(file_fd, &file_stat) == 0 && (error_html = counted_malloc(file_stat.st_size)) != NULL) {
+            if (read(file_fd, error_html, file_stat.st_size) == file_stat.st_size) {
+                body = error_html;
+                body_len = file_stat.st_size;
+                content_type = "text/html; charset=UTF-8";
+            } else {
+                perror("Failed to read error page");
+                counted_free(error_html);
+                error_html = NULL;
+            }
+        }
+        close(file_fd);
+    }
+
+    // One variant per Connection header value
+    char close_headers[512];
+    char keep_alive_headers[512];
+    const char *header_format =
+        "HTTP/1.1 %d %s\r\n"
+        "Content-Type: %s\r\n"
+        "Content-Length: %zu\r\n"
+        "Connection: %s\r\n\r\n";
+    int close_header_len = snprintf(close_headers, sizeof(close_headers), header_format,
+        status_code, status_message, content_type, body_len, "close");
+    int keep_alive_header_len = snprintf(keep_alive_headers, sizeof(keep_alive_headers), header_format,
+        status_code, status_message, content_type, body_len, "keep-alive");
+
+    ErrorPage *page = counted_malloc(sizeof(ErrorPage) + close_header_len + keep_alive_header_len + 2 * body_len);
+    if (page) {
+        page->refcount = 1;
+        page->content_type = content_type;
+        page->close_len = close_header_len + body_len;
+        page->keep_alive_len = keep_alive_header_len + body_len;
+        page->body_len = body_len;
+        char *ptr = page->data;
+        memcpy(ptr, close_headers, close_header_len);
+        memcpy(ptr + close_header_len, body, body_len);
+        ptr += page->close_len;
+        memcpy(ptr, keep_alive_headers, keep_alive_header_len);
+        memcpy(ptr + keep_alive_header_len, body, body_len);
+    }
+    counted_free(error_html);
+    return page;
+}
+
+void release_error_page(ErrorPage *page) {
+    if (page && --page->refcount == 0) {
+        counted_free(page);
+    }
+}
+
+// (Re)load every site's error pages; responses still being sent keep their old copy
+void load_error_pages(void) {
+    for (int site = -1; site < vhost_count; site++) {
+        VirtualHost *vhost = site < 0 ? &default_host : &vhosts[site];
+        for (size_t i = 0; i < ERROR_STATUS_COUNT; i++) {
+            ErrorPage *page = render_error_page(vhost->errors, error_statuses[i].code, error_statuses[i].message,
+                                                vhost == &default_host);
+            if (!page && errno == ENOENT && default_host.error_pages[i]) {
+                // A page the site lacks is the default site's
+                page = default_host.error_pages[i];
+                page->refcount++;
+            }
+            if (!page) {
+                perror("Error page allocation failed");
+                continue;  // Keep the previous version
+            }
+            release_error_page(vhost->error_pages[i]);
+            vhost->error_pages[i] = page;
+        }
+    }
+}
+
+// Watch a directory and everything below it for changes
+void watch_directory(const char *dir) {
+    if (watch_count == MAX_WATCHES) {
+        printf("Too many watched directories, not watching %s\n", dir);
+        return;
+    }
+    int wd = inotify_add_watch(inotify_fd, dir,
+        IN_CLOSE_WRITE | IN_MODIFY | IN_ATTRIB | IN_CREATE | IN_DELETE |
+        IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR);
+    if (wd < 0) {
+        perror("inotify_add_watch failure");
+        return;
+    }
+    // Re-adding an already watched directory returns the same wd
+    int slot = 0;
+    while (slot < watch_count && watched_dirs[slot].wd != wd) {
+        slot++;
+    }
+    if (slot == watch_count) {
+        watch_count++;
+    }
+    watched_dirs[slot].wd = wd;
+    snprintf(watched_dirs[slot].dir, sizeof(watched_dirs[slot].dir), "%s", dir);
+
+    DIR *dir_stream = opendir(dir);
+    if (!dir_stream) {
+        return;
+    }
+    struct dirent *dirent;
+    while ((dirent = readdir(dir_stream)) != NULL) {
+        if (dirent->d_type != DT_DIR || strcmp(dirent->d_name, ".") == 0 || strcmp(dirent->d_name, "..") == 0) {
+            continue;
+        }
+        char subdir[512];
+        if (snprintf(subdir, sizeof(subdir), "%s/%s", dir, dirent->d_name) < (int)sizeof(subdir)) {
+            watch_directory(subdir);
+        }
+    }
+    closedir(dir_stream);
+}
+
+// Whether a watched directory holds some site's error pages
+static int is_errors_dir(const char *dir) {
+    for (int site = -1; site < vhost_count; site++) {
+        const char *errors = site < 0 ? default_host.errors : vhosts[site].errors;
+        size_t len = strlen(errors);
+        if (strncmp(dir, errors, len) == 0 && (dir[len] == '\0' || dir[len] == '/')) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Set up the inotify watcher for the mounted directories, the sites and error pages
+int file_watch_init(void) {
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd < 0) {
+        perror("inotify_init1 failure");
+        return -1;
+    }
+    for (int i = 0; i < config.mount_count; i++) {
+        watch_directory(config.mounts[i].root);
+    }
+    watch_directory("./errors");
+    for (int i = 0; i < vhost_count; i++) {
+        watch_directory(vhosts[i].mount.root);
+        if (access(vhosts[i].errors, F_OK) == 0) {
+            watch_directory(vhosts[i].errors);
+        }
+    }  // Reloads the pre-rendered error pages
+    return inotify_fd;
+}
+
+// Drain inotify and invalidate the cache entries for whatever changed
+void handle_file_events(void) {
+    int errors_changed = 0;
+    char buffer[BUFFER_SIZE] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    while (1) {
+        ssize_t len = read(inotify_fd, buffer, sizeof(buffer));
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                perror("inotify read failure");
+            }
+            break;
+        }
+
+        for (char *ptr = buffer; ptr < buffer + len; ) {
+            struct inotify_event *event = (struct inotify_event *)ptr;
+            ptr += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                // Events were lost - nothing in the cache can be trusted
+                file_cache_invalidate_prefix(NULL);
+                continue;
+            }
+            int slot = 0;
+            while (slot < watch_count && watched_dirs[slot].wd != event->wd) {
+                slot++;
+            }
+            if (slot == watch_count) {
+                continue;
+            }
+            if (event->mask & IN_IGNORED) {
+                // Directory removed - forget the watch
+                watched_dirs[slot] = watched_dirs[--watch_count];
+                continue;
+            }
+            if (event->len == 0) {
+                continue;  // Event on the directory itself
+            }
+
+            if (is_errors_dir(watched_dirs[slot].dir)) {
+                errors_changed = 1;
+            }
+            char changed_path[512];
+            if (snprintf(changed_path, sizeof(changed_path), "%s/%s",
+                         watched_dirs[slot].dir, event->name) >= (int)sizeof(changed_path)) {
+                continue;
+            }
+            if (event->mask & IN_ISDIR) {
+                file_cache_invalidate_prefix(changed_path);
+                if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    watch_directory(changed_path);
+                }
+            } else {
+                file_cache_invalidate(changed_path);
+                // file.br / file.gz are variants of file's entry
+                size_t len = strlen(changed_path);
+                for (int i = 0; i < ENCODING_COUNT; i++) {
+                    if (len > 3 && strcmp(changed_path + len - 3, encoding_suffixes[i]) == 0) {
+                        changed_path[len - 3] = '\0';
+                        file_cache_invalidate(changed_path);
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    // Error pages are pre-rendered, so re-render them rather than invalidate
+    if (errors_changed) {
+        load_error_pages();
+    }
+}
+
+static uint64_t ns_to_tick(uint64_t nanoseconds) {
+    return nanoseconds / (TIMER_TICK_MS * 1000000ULL);
+}
+
+// Put the connection under a deadline seconds after start_tick (0 seconds = none)
+static void arm_timeout(Connection *conn, TimeoutKind kind, uint64_t start_tick, int seconds) {
+    conn->timeout_kind = kind;
+    if (seconds <= 0) {
+        timer_wheel_cancel(&timers, &conn->timer);
+        return;
+    }
+    timer_wheel_add(&timers, &conn->timer, start_tick + (uint64_t)seconds * 1000 / TIMER_TICK_MS);
+}
+
+// Deadline while waiting for input: the rest of a request body, the rest of
+// a request head (also the first one on a new connection), or the next
+// request on a kept-alive connection. A deadline is set when the stage
+// starts and not pushed back by later reads, so trickling bytes
+// (slowloris) does not keep a connection alive
+static void arm_read_timeout(Connection *conn) {
+    if (conn->discard_remaining > 0) {
+        if (conn->timeout_kind != TIMEOUT_BODY) {
+            arm_timeout(conn, TIMEOUT_BODY, current_tick, config.body_timeout);
+        }
+    } else if (conn->in_len > 0 || conn->request_start_ns || conn->requests_served == 0) {
+        if (conn->timeout_kind != TIMEOUT_HEADER) {
+            arm_timeout(conn, TIMEOUT_HEADER, current_tick, config.header_timeout);
+        }
+    } else if (conn->timeout_kind != TIMEOUT_IDLE) {
+        arm_timeout(conn, TIMEOUT_IDLE, current_tick, config.keepalive_timeout);
+    }
+}
+
+// Append one buffer to the response batch
+static void queue_iov(Connection *conn, void *base, size_t len) {
+    conn->iov[conn->iov_count].iov_base = base;
+    conn->iov[conn->iov_count].iov_len = len;
+    conn->iov_count++;
+}
+
+// Can another pipelined response join the current batch?
+// A sendfile() body has to go out before anything queued after it
+static int batch_has_room(Connection *conn) {
+    return conn->response_count < MAX_PIPELINE &&
+           (!conn->arena.base || arena_remaining(&conn->arena) >= REQUEST_ARENA_RESERVE) &&
+           conn->file_fd < 0;
+}
+
+// Give the connection its arena for the batch being built
+// Returns 0 if no memory is available
+static int attach_arena(Connection *conn) {
+    if (!conn->arena.base) {
+        arena_attach(&conn->arena, buffer_pool_get(&arena_pool), ARENA_SIZE);
+    }
+    return conn->arena.base != NULL;
+}
+
+// Release everything the written batch referenced and start an empty one
+static void reset_batch(Connection *conn) {
+    for (int i = 0; i < conn->response_count; i++) {
+        if (conn->cache_entries[i]) {
+            file_cache_release(conn->cache_entries[i]);
+        }
+        release_error_page(conn->error_pages[i]);
+    }
+    conn->response_count = 0;
+    if (conn->arena.used > arena_high_water) {
+        arena_high_water = conn->arena.used;
+    }
+    buffer_pool_put(&arena_pool, conn->arena.base);
+    arena_attach(&conn->arena, NULL, 0);
+    conn->iov_count = 0;
+    conn->iov_index = 0;
+    conn->file_fd = -1;
+    conn->range_parts = NULL;
+    conn->range_part_count = 0;
+    conn->range_part_index = 0;
+    conn->batch_start_ns = 0;
+    conn->batch_parsed_ns = 0;
+    conn->first_write_ns = 0;
+}
+
+// Attach a cache entry's body to the response: in memory when it was
+// small enough, otherwise streamed from its fd with sendfile()
+void stage_body(Connection *conn, FileCacheEntry *entry) {
+    if (entry->data) {
+        queue_iov(conn, entry->data, entry->data_len);
+    } else if (entry->st.st_size > 0) {
+        conn->file_fd = entry->fd;
+        conn->file_offset = entry->body_offset;
+        conn->file_end = entry->body_offset + entry->st.st_size;
+    }
+}
+
+// Same for a compressed variant
+static void stage_variant_body(Connection *conn, EncodedVariant *variant) {
+    if (variant->data) {
+        queue_iov(conn, variant->data, variant->length);
+    } else if (variant->length > 0) {
+        conn->file_fd = variant->fd;
+        conn->file_offset = variant->offset;
+        conn->file_end = variant->offset + variant->length;
+    }
+}
+
+// Count the response just staged and queue its access log record; the
+// request line comes from the parser slices, which are empty if it never parsed
+static void record_response(Connection *conn, int status_code, long long bytes) {
+    const HttpParser *parser = &conn->parser;
+    const char *data = conn->in_buf;
+    MetricsMethod method = METHOD_NONE;
+    if (data && parser->method.length > 0) {
+        if (http_slice_equals(data, parser->method, "GET")) {
+            method = METHOD_GET;
+        } else if (http_slice_equals(data, parser->method, "HEAD")) {
+            method = METHOD_HEAD;
+        } else if (http_slice_equals(data, parser->method, "POST")) {
+            method = METHOD_POST;
+        } else {
+            method = METHOD_OTHER;
+        }
+    }
+    metrics_count_response(method, status_code);
+
+    if (!access_log_enabled()) {
+        return;
+    }
+    AccessLogEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.time = server_clock.second;
+    entry.client = conn->client_ip;
+    entry.status = status_code;
+    entry.bytes = bytes;
+    if (data && parser->method.length > 0) {
+        entry.method = data + parser->method.offset;
+        entry.method_len = parser->method.length;
+        entry.target = data + parser->target.offset;
+        entry.target_len = parser->target.length;
+        entry.protocol = data + parser->version.offset;
+        entry.protocol_len = parser->version.length;
+    }
+    if (data && config.access_log_format != ACCESS_LOG_COMMON) {
+        const HttpHeaderField *referer = http_parser_header(parser, data, "Referer");
+        if (referer) {
+            entry.referer = data + referer->value.offset;
+            entry.referer_len = referer->value.length;
+        }
+        const HttpHeaderField *user_agent = http_parser_header(parser, data, "User-Agent");
+        if (user_agent) {
+            entry.user_agent = data + user_agent->value.offset;
+            entry.user_agent_len = user_agent->value.length;
+        }
+    }
+    access_log_write(&entry);
+}
+
+// Stage an HTTP error response on the connection
+// Known statuses use the response pre-rendered by load_error_pages()
+void send_error_response(Connection *conn, int status_code, const char *status_message) {
+    int slot = conn->response_count++;
+    conn->cache_entries[slot] = NULL;
+    conn->error_pages[slot] = NULL;
+
+    ErrorPage **error_pages = conn->vhost->error_pages;
+    for (size_t i = 0; i < ERROR_STATUS_COUNT; i++) {
+        if (error_statuses[i].code == status_code && error_pages[i]) {
+            ErrorPage *page = error_pages[i];
+            page->refcount++;
+            conn->error_pages[slot] = page;
+            if (conn->keep_alive) {
+                queue_iov(conn, page->data + page->close_len, page->keep_alive_len);
+            } else {
+                queue_iov(conn, page->data, page->close_len);
+            }
+            debug_log(1, "Sent %d %s response\n", status_code, status_message);
+            record_response(conn, status_code, page->body_len);
+            return;
+        }
+    }
+
+    // Fallback: simple error for a status without a pre-rendered page
+    const char *fallback = "<html><body><h1>Error</h1><p>An error occurred.</p></body></html>";
+    int len = 0;
+    char *response = attach_arena(conn) ? arena_printf(&conn->arena, &len,
+        "HTTP/1.1 %d %s\r\n"
+        "Content-Type: text/html\r\n"
+        "Content-Length: %zu\r\n"
+        "Connection: %s\r\n\r\n%s",
+        status_code, status_message, strlen(fallback),
+        conn->keep_alive ? "keep-alive" : "close", fallback) : NULL;
+    if (!response) {
+        fprintf(stderr, "Out of memory for %d response - closing connection\n", status_code);
+        conn->keep_alive = 0;
+        return;
+    }
+    queue_iov(conn, response, len);
+    record_response(conn, status_code, strlen(fallback));
+}
+
+// Reason phrase for a status with a pre-rendered error page
+const char *status_message(int status_code) {
+    for (size_t i = 0; i < ERROR_STATUS_COUNT; i++) {
+        if (error_statuses[i].code == status_code) {
+            return error_statuses[i].message;
+        }
+    }
+    return "Error";
+}
+
+// 405: the pre-rendered page's body, behind headers carrying the Allow
+// list the status requires, which depends on the route
+static void send_method_not_allowed(Connection *conn, unsigned allowed) {
+    ErrorPage *page = NULL;
+    for (size_t i = 0; i < ERROR_STATUS_COUNT; i++) {
+        if (error_statuses[i].code == 405) {
+            page = conn->vhost->error_pages[i];
+        }
+    }
+    char methods[64];
+    router_format_allowed(allowed, methods, sizeof(methods));
+    int header_len = 0;
+    char *headers = page && attach_arena(conn) ? arena_printf(&conn->arena, &header_len,
+        "HTTP/1.1 405 Method Not Allowed\r\n"
+        "Allow: %s\r\n"
+        "Content-Type: %s\r\n"
+        "Content-Length: %zu\r\n"
+        "Connection: %s\r\n\r\n",
+        methods, page->content_type, page->body_len, conn->keep_alive ? "keep-alive" : "close") : NULL;
+    if (!headers) {
+        send_error_response(conn, 405, "Method Not Allowed");
+        return;
+    }
+    page->refcount++;
+    int slot = conn->response_count++;
+    conn->cache_entries[slot] = NULL;
+    conn->error_pages[slot] = page;
+    queue_iov(conn, headers, header_len);
+    queue_iov(conn, page->data + page->close_len - page->body_len, page->body_len);
+    debug_log(1, "Sent 405 Method Not Allowed response (Allow: %s)\n", methods);
+    record_response(conn, 405, page->body_len);
+}
+
+// Liveness probe (-E): a fixed answer that touches nothing but the arena
+static void send_health_response(Connection *conn, const RouteMatch *match, int is_head) {
+    (void)match;
+    int len = 0;
+    char *response = attach_arena(conn) ? arena_printf(&conn->arena, &len,
+        "HTTP/1.1 200 OK\r\n"
+        "Date: %s\r\n"
+        "Content-Type: text/plain\r\n"
+        "Content-Length: 3\r\n"
+        "Cache-Control: no-store\r\n"
+        "Connection: %s\r\n\r\n%s",
+        server_clock.http_date, conn->keep_alive ? "keep-alive" : "close", is_head ? "" : "ok\n") : NULL;
+    if (!response) {
+        send_error_response(conn, 500, "Internal Server Error");
+        return;
+    }
+    int slot = conn->response_count++;
+    conn->cache_entries[slot] = NULL;
+    conn->error_pages[slot] = NULL;
+    queue_iov(conn, response, len);
+    record_response(conn, 200, is_head ? 0 : 3);
+}
+
+// Stage the Prometheus metrics of all workers as a one-off page
+static void send_metrics_response(Connection *conn, const RouteMatch *match, int is_head) {
+    static char body[METRICS_BUFFER_SIZE];
+    (void)match;
+    int body_len = metrics_render(body, sizeof(body));
+    if (body_len < 0) {
+        fprintf(stderr, "Metrics do not fit in %d bytes\n", METRICS_BUFFER_SIZE);
+        send_error_response(conn, 500, "Internal Server Error");
+        return;
+    }
+    char headers[256];
+    int header_len = snprintf(headers, sizeof(headers),
+        "HTTP/1.1 200 OK\r\n"
+        "Date: %s\r\n"
+        "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+        "Content-Length: %d\r\n"
+        "Cache-Control: no-store\r\n"
+        "Connection: %s\r\n\r\n",
+        server_clock.http_date, body_len, conn->keep_alive ? "keep-alive" : "close");
+
+    ErrorPage *page = counted_malloc(sizeof(ErrorPage) + header_len + body_len);
+    if (!page) {
+        send_error_response(conn, 500, "Internal Server Error");
+        return;
+    }
+    page->refcount = 1;
+    page->content_type = "text/plain; version=0.0.4; charset=utf-8";
+    page->close_len = 0;
+    page->keep_alive_len = header_len + body_len;
+    page->body_len = body_len;
+    memcpy(page->data, headers, header_len);
+    memcpy(page->data + header_len, body, body_len);
+
+    int slot = conn->response_count++;
+    conn->cache_entries[slot] = NULL;
+    conn->error_pages[slot] = page;
+    queue_iov(conn, page->data, is_head ? (size_t)header_len : page->keep_alive_len);
+    record_response(conn, 200, is_head ? 0 : body_len);
+}
+
+// Evaluate If-None-Match (or, without it, If-Modified-Since) against a file's validators
+// Returns 1 if the client's copy is current
+static int is_not_modified(const HttpParser *parser, const char *data, const char *etag, time_t mtime) {
+    const HttpHeaderField *if_none_match = http_parser_header(parser, data, "If-None-Match");
+    if (if_none_match) {
+        return http_etag_list_matches(data + if_none_match->value.offset, if_none_match->value.length, etag);
+    }
+    const HttpHeaderField *if_modified_since = http_parser_header(parser, data, "If-Modified-Since");
+    time_t since;
+    return if_modified_since &&
+           http_parse_date(data + if_modified_since->value.offset, if_modified_since->value.length, &since) == 0 &&
+           mtime <= since;
+}
+
+// Stage a 304 carrying the validators and Cache-Control a 200 would have had
+static void send_not_modified(Connection *conn, const char *etag, const char *last_modified,
+                              const char *cache_control, int vary) {
+    int len = 0;
+    char *response = arena_printf(&conn->arena, &len,
+        "HTTP/1.1 304 Not Modified\r\n"
+        "Date: %s\r\n"
+        "Connection: %s\r\n"
+        "Server: MyHTTPServer/1.0\r\n"
+        "ETag: %s\r\n"
+        "Last-Modified: %s\r\n"
+        "%s"
+        "%s%s%s\r\n",
+        server_clock.http_date, conn->keep_alive ? "keep-alive" : "close", etag, last_modified,
+        vary ? "Vary: Accept-Encoding\r\n" : "", cache_control ? "Cache-Control: " : "", cache_control ? cache_control : "", cache_control ? "\r\n" : "");
+    if (!response) {
+        send_error_response(conn, 500, "Internal Server Error");
+        return;
+    }
+    int slot = conn->response_count++;
+    conn->cache_entries[slot] = NULL;
+    conn->error_pages[slot] = NULL;
+    queue_iov(conn, response, len);
+    record_response(conn, 304, 0);
+}
+
+// Conditional request for a file that is not cached: decide from stat()
+// alone so a 304 never opens or reads the file
+// Returns 1 if a 304 was staged, 0 if the file has to be served
+static int send_not_modified_uncached(Connection *conn, const char *file_path) {
+    struct stat st;
+    if (stat(file_path, &st) < 0 || !S_ISREG(st.st_mode)) {
+        return 0;  // The cache load reports the error
+    }
+    char etag[48];
+    format_etag(etag, sizeof(etag), &st);
+    if (!is_not_modified(&conn->parser, conn->in_buf, etag, st.st_mtime)) {
+        return 0;
+    }
+    char last_modified[32];
+    format_http_date(last_modified, sizeof(last_modified), st.st_mtime);
+    int vary = mime_is_compressible(mime_type_for_path(file_path)) && st.st_size >= COMPRESS_MIN_SIZE;
+    send_not_modified(conn, etag, last_modified, cache_control_for(file_path), vary);
+    return 1;
+}
+
+// Stage a 416 for a Range the file cannot satisfy
+static void send_range_not_satisfiable(Connection *conn, FileCacheEntry *entry) {
+    int len = 0;
+    char *response = arena_printf(&conn->arena, &len,
+        "HTTP/1.1 416 Range Not Satisfiable\r\n"
+        "Date: %s\r\n"
+        "Connection: %s\r\n"
+        "Server: MyHTTPServer/1.0\r\n"
+        "Content-Range: bytes */%lld\r\n"
+        "Content-Length: 0\r\n\r\n",
+        server_clock.http_date, conn->keep_alive ? "keep-alive" : "close", (long long)entry->st.st_size);
+    file_cache_release(entry);
+    if (!response) {
+        send_error_response(conn, 500, "Internal Server Error");
+        return;
+    }
+    int slot = conn->response_count++;
+    conn->cache_entries[slot] = NULL;
+    conn->error_pages[slot] = NULL;
+    queue_iov(conn, response, len);
+    record_response(conn, 416, 0);
+}
+
+// Stage a 206 for the satisfiable ranges of a cached file, with the
+// validators and Cache-Control a 200 would have had. One range is a
+// plain body; several become a multipart/byteranges body whose parts
+// handle_write() sends one by one, each range straight from the cached fd
+// Returns 0 (nothing staged) if the arena cannot hold the part headers
+static int send_partial_content(Connection *conn, FileCacheEntry *entry, const HttpRange *ranges, int count) {
+    long long size = entry->st.st_size;
+    const char *connection = conn->keep_alive ? "keep-alive" : "close";
+    const char *cache_control = entry->cache_control;
+    int len = 0;
+
+    if (count == 1) {
+        char *headers = arena_printf(&conn->arena, &len,
+            "HTTP/1.1 206 Partial Content\r\n"
+            "Date: %s\r\n"
+            "Connection: %s\r\n"
+            "Server: MyHTTPServer/1.0\r\n"
+            "Content-Type: %s\r\n"
+            "Content-Length: %lld\r\n"
+            "Content-Range: bytes %lld-%lld/%lld\r\n"
+            "Accept-Ranges: bytes\r\n"
+            "%s"
+            "ETag: %s\r\n"
+            "Last-Modified: %s\r\n"
+            "%s%s%s\r\n",
+            server_clock.http_date, connection, entry->content_type,
+            ranges[0].last - ranges[0].first + 1, ranges[0].first, ranges[0].last, size,
+            entry->compressible ? "Vary: Accept-Encoding\r\n" : "", entry->etag, entry->last_modified,
+            cache_control ? "Cache-Control: " : "", cache_control ? cache_control : "", cache_control ? "\r\n" : "");
+        if (!headers) {
+            return 0;
+        }
+        queue_iov(conn, headers, len);
+        if (entry->data) {
+            queue_iov(conn, entry->data + ranges[0].first, ranges[0].last - ranges[0].first + 1);
+        } else {
+            conn->file_fd = entry->fd;
+            conn->file_offset = entry->body_offset + ranges[0].first;
+            conn->file_end = entry->body_offset + ranges[0].last + 1;
+        }
+        int slot = conn->response_count++;
+        conn->cache_entries[slot] = entry;
+        conn->error_pages[slot] = NULL;
+        record_response(conn, 206, ranges[0].last - ranges[0].first + 1);
+        return 1;
+    }
+
+    // Boundary unique enough not to occur in the file
+    static unsigned long boundary_counter;
+    char boundary[48];
+    snprintf(boundary, sizeof(boundary), "%08lx%08lx%06lx",
+             (unsigned long)server_clock.second, (unsigned long)getpid(), ++boundary_counter & 0xffffff);
+
+    // Every part header, then the closing boundary as a final empty part
+    RangePart *parts = arena_alloc(&conn->arena, sizeof(RangePart) * (count + 1));
+    if (!parts) {
+        return 0;
+    }
+    long long body_len = 0;
+    for (int i = 0; i < count; i++) {
+        parts[i].header = arena_printf(&conn->arena, &len,
+            "%s--%s\r\n"
+            "Content-Type: %s\r\n"
+            "Content-Range: bytes %lld-%lld/%lld\r\n\r\n",
+            i == 0 ? "" : "\r\n", boundary, entry->content_type, ranges[i].first, ranges[i].last, size);
+        if (!parts[i].header) {
+            return 0;
+        }
+        parts[i].header_len = len;
+        parts[i].start = entry->body_offset + ranges[i].first;
+        parts[i].end = entry->body_offset + ranges[i].last + 1;
+        body_len += len + (ranges[i].last - ranges[i].first + 1);
+    }
+    parts[count].header = arena_printf(&conn->arena, &len, "\r\n--%s--\r\n", boundary);
+    if (!parts[count].header) {
+        return 0;
+    }
+    parts[count].header_len = len;
+    parts[count].start = parts[count].end = 0;
+    body_len += len;
+
+    char *headers = arena_printf(&conn->arena, &len,
+        "HTTP/1.1 206 Partial Content\r\n"
+        "Date: %s\r\n"
+        "Connection: %s\r\n"
+        "Server: MyHTTPServer/1.0\r\n"
+        "Content-Type: multipart/byteranges; boundary=%s\r\n"
+        "Content-Length: %lld\r\n"
+        "Accept-Ranges: bytes\r\n"
+        "%s"
+        "ETag: %s\r\n"
+        "Last-Modified: %s\r\n"
+        "%s%s%s\r\n",
+        server_clock.http_date, connection, boundary, body_len,
+        entry->compressible ? "Vary: Accept-Encoding\r\n" : "", entry->etag, entry->last_modified,
+        cache_control ? "Cache-Control: " : "", cache_control ? cache_control : "", cache_control ? "\r\n" : "");
+    if (!headers) {
+        return 0;
+    }
+    queue_iov(conn, headers, len);
+    queue_iov(conn, parts[0].header, parts[0].header_len);
+    conn->file_fd = entry->fd;
+    conn->file_offset = parts[0].start;
+    conn->file_end = parts[0].end;
+    conn->range_parts = parts;
+    conn->range_part_count = count + 1;
+    conn->range_part_index = 1;
+    int slot = conn->response_count++;
+    conn->cache_entries[slot] = entry;
+    conn->error_pages[slot] = NULL;
+    record_response(conn, 206, body_len);
+    return 1;
+}
+
+// Pick the compressed variant the client weighs highest (br on a tie), and
+// start gzip'ing the file if it has no gzip variant yet
+// Returns NULL to send the identity body
+static EncodedVariant *negotiate_encoding(const HttpParser *parser, const char *data, FileCacheEntry *entry) {
+    const HttpHeaderField *accept = http_parser_header(parser, data, "Accept-Encoding");
+    if (!accept) {
+        return NULL;
+    }
+    const char *value = data + accept->value.offset;
+    if (!entry->variants[ENCODING_GZIP] && http_accept_encoding_quality(value, accept->value.length, "gzip") > 0) {
+        file_cache_compress(entry);
+    }
+    EncodedVariant *best = NULL;
+    int best_quality = 0;
+    for (int i = 0; i < ENCODING_COUNT; i++) {
+        int quality = entry->variants[i] ?
+                      http_accept_encoding_quality(value, accept->value.length, encoding_names[i]) : 0;
+        if (quality > best_quality) {
+            best = entry->variants[i];
+            best_quality = quality;
+        }
+    }
+    return best;
+}
+
+// Serve the file a static mount maps the rest of the path to; returns 0
+// like process_request when the I/O pool opens it
+static int serve_static(Connection *conn, const StaticMount *mount, const RouteMatch *match, int is_head) {
+    const char *timestamp = server_clock.log_timestamp;
+    const HttpParser *parser = &conn->parser;
+    const char *data = conn->in_buf;
+
+    // build file path: the mount's root, then what the wildcard matched,
+    // plus 'index.html' for a directory
+    const RouteParam *rest = &match->params[match->param_count - 1];
+    int is_directory = rest->length == 0 || rest->value[rest->length - 1] == '/';
+    char file_path[512];
+    if (snprintf(file_path, sizeof(file_path), "%s/%.*s%s", mount->root, (int)rest->length, rest->value,
+                 is_directory ? "index.html" : "") >= (int)sizeof(file_path)) {
+        send_error_response(conn, 414, "URI Too Long");
+        return 1;
+    }
+
+    // Conditional GET/HEAD: a cached entry already has the validators,
+    // otherwise stat() is enough to answer 304 without opening the file
+    // (with an I/O pool, stat() could block too: the pool opens the file)
+    FileCacheEntry *entry = NULL;
+    int conditional = !http_slice_equals(data, parser->method, "POST") &&
+                      (http_parser_header(parser, data, "If-None-Match") ||
+                       http_parser_header(parser, data, "If-Modified-Since"));
+    if (conn->file_loaded) {
+        // Second run, with the file the I/O pool opened
+        conn->file_loaded = 0;
+        entry = conn->loaded_entry;
+        conn->loaded_entry = NULL;
+        errno = conn->loaded_errno;
+    } else if (asset_pack.base) {
+        // Everything is in the pack: no stat() or open(), and what it lacks is a 404
+        entry = asset_pack_acquire(file_path);
+    } else {
+        if (conditional) {
+            entry = file_cache_lookup(file_path);
+            if (!entry && io_pool_fd < 0 && send_not_modified_uncached(conn, file_path)) {
+                debug_log(1, "[%s] 304 Not Modified - %s (not cached)\n", timestamp, file_path);
+                return 1;
+            }
+        }
+
+        // Look up the file (opened, stat'ed and typed once, then served from the cache)
+        if (!conditional) {
+            entry = file_cache_lookup(file_path);
+        }
+        if (!entry && start_file_load(conn, &conn->vhost->cache, file_path) == 0) {
+            conn->requests_served--;  // Counted again when the request runs for real
+            return 0;
+        }
+        if (!entry) {
+            entry = file_cache_load_miss(&conn->vhost->cache, file_path);
+        }
+    }
+    if (!entry) {
+        if (errno == ENOENT || errno == ENOTDIR) {
+            debug_log(1, "File not found: %s\n", file_path);
+            send_error_response(conn, 404, "Not Found");
+        } else if (errno == EACCES) {
+            debug_log(1, "File not servable: %s\n", file_path);
+            send_error_response(conn, 403, "Forbidden");
+        } else {
+            perror("File open failure");
+            send_error_response(conn, 500, "Internal Server Error");
+        }
+        return 1;
+    }
+
+    // Content negotiation; a range is always served from the identity body
+    const HttpHeaderField *range = is_head ? NULL : http_parser_header(parser, data, "Range");
+    EncodedVariant *variant = entry->compressible && !range ? negotiate_encoding(parser, data, entry) : NULL;
+
+    const char *etag = variant ? variant->etag : entry->etag;
+    if (conditional && is_not_modified(parser, data, etag, entry->st.st_mtime)) {
+        debug_log(1, "[%s] 304 Not Modified - %s\n", timestamp, file_path);
+        send_not_modified(conn, etag, entry->last_modified, entry->cache_control, entry->compressible);
+        file_cache_release(entry);
+        return 1;
+    }
+
+    // Range: only for GET, and (with If-Range) only while the file is unchanged:
+    // an If-Range entity-tag must match exactly (strong comparison), a date
+    // must be the file's Last-Modified
+    const HttpHeaderField *if_range = range ? http_parser_header(parser, data, "If-Range") : NULL;
+    if (range && (!if_range || http_slice_equals(data, if_range->value, entry->etag) ||
+                  http_slice_equals(data, if_range->value, entry->last_modified))) {
+        HttpRange ranges[HTTP_MAX_RANGES];
+        int count = http_parse_range(data + range->value.offset, range->value.length,
+                                     entry->st.st_size, ranges, HTTP_MAX_RANGES);
+        if (count == HTTP_RANGE_UNSATISFIABLE) {
+            debug_log(1, "[%s] 416 Range Not Satisfiable - %s\n", timestamp, file_path);
+            send_range_not_satisfiable(conn, entry);
+            return 1;
+        }
+        if (count > 0 && send_partial_content(conn, entry, ranges, count)) {
+            debug_log(1, "[%s] 206 Partial Content - %d range(s) of %s\n", timestamp, count, file_path);
+            return 1;
+        }
+    }
+
+    //Build HTTP response: per-request status line, Date and Connection, then the cached header block
+    int status_len = 0;
+    char *status = arena_printf(&conn->arena, &status_len,
+        "HTTP/1.1 200 OK\r\n"
+        "Date: %s\r\n"
+        "Connection: %s\r\n", server_clock.http_date, conn->keep_alive ? "keep-alive" : "close");
+    if (!status) {
+        file_cache_release(entry);
+        send_error_response(conn, 500, "Internal Server Error");
+        return 1;
+    }
+    queue_iov(conn, status, status_len);
+    if (variant) {
+        queue_iov(conn, variant->header, variant->header_len);
+    } else {
+        queue_iov(conn, entry->header, entry->header_len);
+    }
+    int slot = conn->response_count++;
+    conn->cache_entries[slot] = entry;
+    conn->error_pages[slot] = NULL;
+
+    // HEAD METHOD HANDLING HERE - headers only
+    if(is_head) {
+        debug_log(1, "[%s] 200 OK - HEAD request for %s\n", timestamp, file_path);
+        record_response(conn, 200, 0);
+        return 1;
+    }
+    if (variant) {
+        stage_variant_body(conn, variant);
+        debug_log(1, "[%s] 200 OK - Served %s (%s)\n", timestamp, file_path,
+                  variant == entry->variants[ENCODING_BR] ? "br" : "gzip");
+        record_response(conn, 200, variant->length);
+        return 1;
+    }
+    stage_body(conn, entry);
+    debug_log(1, "[%s] 200 OK - Served %s\n", timestamp, file_path);
+    record_response(conn, 200, entry->st.st_size);
+    return 1;
+}
+
+// Virtual host of a name (NULL-terminated, normalized), or NULL
+static VirtualHost *vhost_find(const char *name) {
+    for (size_t slot = hash_path(name) & vhost_mask; vhost_table[slot]; slot = (slot + 1) & vhost_mask) {
+        if (strcmp(vhost_table[slot]->name, name) == 0) {
+            return vhost_table[slot];
+        }
+    }
+    return NULL;
+}
+
+// Site a request is for: its Host normalized - lower case, without the port
+// or a trailing dot - looked up as is, then as "*.parent" for each parent
+// domain (the nearest wins); the default site when nothing matches
+static VirtualHost *vhost_for(const HttpParser *parser, const char *data) {
+    const HttpHeaderField *host = vhost_count ? http_parser_header(parser, data, "Host") : NULL;
+    if (!host) {
+        return &default_host;
+    }
+    const char *value = data + host->value.offset;
+    size_t len = host->value.length;
+    const char *end = len > 0 && value[0] == '[' ? memchr(value, ']', len) : NULL;  // IPv6 literal
+    const char *port = memchr(end ? end : value, ':', len - (end ? end - value : 0));
+    if (port) {
+        len = port - value;
+    }
+    while (len > 0 && value[len - 1] == '.') {
+        len--;
+    }
+    char name[256];
+    if (len == 0 || len >= sizeof(name)) {
+        return &default_host;
+    }
+    for (size_t i = 0; i < len; i++) {
+        name[i] = value[i] >= 'A' && value[i] <= 'Z' ? value[i] + ('a' - 'A') : value[i];
+    }
+    name[len] = '\0';
+    VirtualHost *vhost = vhost_find(name);
+    for (const char *dot = strchr(name + 1, '.'); !vhost && dot; dot = strchr(dot + 1, '.')) {
+        vhost = vhost_find(dot);
+    }
+    return vhost ? vhost : &default_host;
+}
+
+// Handle the request whose head conn->parser has just completed
+// Appends its response to the connection's batch and decides keep_alive.
+// Returns 0 if the request waits for its file on the I/O pool instead
+// (see start_file_load); it is run again from the start once the file is open
+int process_request(Connection *conn) {
+    const HttpParser *parser = &conn->parser;
+    const char *data = conn->in_buf;
+
+    // Anything that fails before the headers are understood closes the connection
+    conn->keep_alive = 0;
+
+    // The site first, so even a malformed request gets its error pages
+    conn->vhost = vhost_for(parser, data);
+
+    // A request body (POST) is skipped so the next pipelined request lines up
+    if (parser->content_length > 0) {
+        conn->discard_remaining = parser->content_length;
+    }
+
+    // Check for a known HTTP method; whether the path takes it is up to its route
+    int method = router_method(data + parser->method.offset, parser->method.length);
+    int is_head = method == ROUTER_HEAD;
+    if (method < 0) {
+        debug_log(1, "Invalid HTTP method: %.*s\n", (int)parser->method.length, data + parser->method.offset);
+        send_error_response(conn, 400, "Bad Request");
+        return 1;
+    }
+
+    // Check for valid HTTP version (HTTP/1.0 or HTTP/1.1)
+    int is_http11 = http_slice_equals(data, parser->version, "HTTP/1.1");
+    if (!is_http11 && !http_slice_equals(data, parser->version, "HTTP/1.0")) {
+        debug_log(1, "Invalid HTTP version: %.*s\n", (int)parser->version.length, data + parser->version.offset);
+        send_error_response(conn, 400, "Bad Request");
+        return 1;
+    }
+
+    // Exactly one Host, though HTTP/1.0 may leave it out (RFC 9112 section 3.2)
+    int host_count = 0;
+    for (int i = 0; i < parser->header_count; i++) {
+        host_count += http_slice_equals_nocase(data, parser->headers[i].name, "Host");
+    }
+    if (host_count > 1 || (host_count == 0 && is_http11)) {
+        debug_log(1, "Request with %d Host headers\n", host_count);
+        send_error_response(conn, 400, "Bad Request");
+        return 1;
+    }
+
+    // The target is the only part of the request that gets copied: the
+    // decoded path, then the query string split and decoded after it
+    if (parser->target.length >= MAX_PATH_LENGTH) {
+        send_error_response(conn, 414, "URI Too Long");
+        return 1;
+    }
+    char *path = attach_arena(conn) ? arena_alloc(&conn->arena, parser->target.length + 1) : NULL;
+    if (!path) {
+        send_error_response(conn, 500, "Internal Server Error");
+        return 1;
+    }
+    const char *target = data + parser->target.offset;
+    const char *question = memchr(target, '?', parser->target.length);
+    size_t path_length = question ? (size_t)(question - target) : parser->target.length;
+    http_url_decode(path, target, path_length);
+    HttpQueryParam *query = NULL;
+    int query_count = 0;
+    if (question) {
+        char *raw_query = path + path_length + 1;
+        size_t query_length = parser->target.length - path_length - 1;
+        memcpy(raw_query, question + 1, query_length);
+        raw_query[query_length] = '\0';
+        query = arena_alloc(&conn->arena, MAX_QUERY_PARAMS * sizeof(HttpQueryParam));
+        query_count = query ? http_parse_query(raw_query, query, MAX_QUERY_PARAMS) : 0;
+    }
+    if (config.verbosity >= 2) {
+        debug_log(2, "%s:%d %.*s %.*s %.*s\n", conn->client_ip, conn->client_port,
+                  (int)parser->method.length, data + parser->method.offset,
+                  (int)parser->target.length, data + parser->target.offset,
+                  (int)parser->version.length, data + parser->version.offset);
+        for (int i = 0; i < parser->header_count; i++) {
+            const HttpHeaderField *field = &parser->headers[i];
+            debug_log(2, "  %.*s: %.*s\n", (int)field->name.length, data + field->name.offset,
+                      (int)field->value.length, data + field->value.offset);
+        }
+        for (int i = 0; i < query_count; i++) {
+            debug_log(2, "  query %s = %s\n", query[i].key, query[i].value);
+        }
+    }
+
+    // Path traversal security check
+    if (strstr(path, "..") != NULL) {
+        debug_log(1, "Path traversal attempt detected: %s\n", path);
+        send_error_response(conn, 400, "Bad Request");
+        return 1;
+    }
+
+    // Keep-Alive: default for HTTP/1.1, opt-in for HTTP/1.0, bounded per connection
+    const HttpHeaderField *connection = http_parser_header(parser, data, "Connection");
+    if (is_http11) {
+        conn->keep_alive = !(connection && http_slice_equals_nocase(data, connection->value, "close"));
+    } else {
+        conn->keep_alive = connection && http_slice_equals_nocase(data, connection->value, "keep-alive");
+    }
+    conn->requests_served++;
+    if (config.keepalive_timeout <= 0 || conn->requests_served >= config.max_requests) {
+        conn->keep_alive = 0;
+    }
+
+    RouteMatch match;
+    if (!router_match(&router, method, path, &match)) {
+        debug_log(1, "No route for %s\n", path);
+        send_error_response(conn, 404, "Not Found");
+        return 1;
+    }
+    const Route *route = match.target;
+    if (!route) {
+        send_method_not_allowed(conn, match.allowed);
+        return 1;
+    }
+    if (route->handler) {
+        route->handler(conn, &match, is_head);
+        return 1;
+    }
+    // A virtual host serves its own directory in place of the one at /
+    const StaticMount *mount = route->mount;
+    if (conn->vhost != &default_host && mount->prefix_len == 1) {
+        mount = &conn->vhost->mount;
+    }
+    return serve_static(conn, mount, &match, is_head);
+}
+
+// Drop n bytes from the front of the receive buffer
+static void consume_input(Connection *conn, size_t n) {
+    if (n == 0) {
+        return;
+    }
+    memmove(conn->in_buf, conn->in_buf + n, conn->in_len - n);
+    conn->in_len -= n;
+    conn->in_buf[conn->in_len] = '\0';
+}
+
+// The request at the front of in_buf has been parsed (or rejected)
+static void note_request_parsed(Connection *conn) {
+    uint64_t now = metrics_now();
+    if (conn->request_start_ns == 0) {
+        conn->request_start_ns = now;
+    }
+    metrics_record(STAGE_READ_TO_PARSED, now - conn->request_start_ns);
+    if (conn->batch_parsed_ns == 0) {
+        conn->batch_start_ns = conn->request_start_ns;
+        conn->batch_parsed_ns = now;
+    }
+}
+
+// Answer the request whose head the parser holds and move on to the next
+// Returns 0 if it waits for the I/O pool; its head stays at the front of in_buf
+static int answer_request(Connection *conn) {
+    if (!process_request(conn)) {
+        return 0;
+    }
+    consume_input(conn, conn->parser.head_length);
+    http_parser_init(&conn->parser);
+    // A pipelined request already in the buffer arrived with the last read
+    conn->request_start_ns = conn->in_len > 0 ? conn->last_read_ns : 0;
+    return 1;
+}
+
+// Answer every complete request at the front of in_buf, batching the
+// responses so pipelined requests go out in as few writes as possible
+void process_pipeline(Connection *conn) {
+    // A request that waited for the I/O pool goes first (see file_load_done)
+    if (conn->file_loaded) {
+        answer_request(conn);
+    }
+    while (conn->keep_alive && batch_has_room(conn)) {
+        // Skip the body of the previous request
+        if (conn->discard_remaining > 0) {
+            size_t skip = conn->in_len < conn->discard_remaining ? conn->in_len : conn->discard_remaining;
+            consume_input(conn, skip);
+            conn->discard_remaining -= skip;
+            if (conn->discard_remaining > 0) {
+                break;
+            }
+        }
+
+        // Resumes where the last call stopped - earlier bytes are not rescanned
+        HttpParseResult result = http_parser_execute(&conn->parser, conn->in_buf, conn->in_len, &config.limits);
+        if (result == HTTP_PARSE_DONE) {
+            note_request_parsed(conn);
+            if (!answer_request(conn)) {
+                break;
+            }
+        } else if (result == HTTP_PARSE_ERROR) {
+            note_request_parsed(conn);
+            int status_code = conn->parser.error_status;
+            debug_log(1, "Invalid request - answering %d\n", status_code);
+            conn->keep_alive = 0;
+            send_error_response(conn, status_code, status_message(status_code));
+        } else if (conn->peer_closed && conn->in_len > 0) {
+            note_request_parsed(conn);
+            debug_log(1, "Client closed mid-request\n");
+            conn->keep_alive = 0;
+            send_error_response(conn, 400, "Bad Request");
+        } else {
+            break;  // Wait for the rest of the request
+        }
+    }
+
+    // Connections waiting for their next request hold no receive buffer
+    if (conn->in_len == 0 && conn->in_buf) {
+        buffer_pool_put(&receive_pool, conn->in_buf);
+        conn->in_buf = NULL;
+    }
+
+    if (conn->file_load) {
+        // Responses already batched go out with the waiting one
+        arm_timeout(conn, TIMEOUT_REQUEST, ns_to_tick(conn->batch_start_ns), config.request_timeout);
+        conn->state = CONN_WAITING_FILE;
+    } else if (conn->response_count > 0) {
+        arm_timeout(conn, TIMEOUT_REQUEST, ns_to_tick(conn->batch_start_ns), config.request_timeout);
+        conn->state = CONN_SENDING_HEADERS;
+    } else if (!conn->keep_alive || conn->peer_closed) {
+        conn->state = CONN_CLOSING;
+    }
+}
+
+// n bytes have been appended to in_buf
+static void note_bytes_read(Connection *conn, size_t n) {
+    conn->last_read_ns = metrics_now();
+    if (conn->request_start_ns == 0) {
+        conn->request_start_ns = conn->last_read_ns;
+    }
+    if (conn->accepted_ns) {
+        metrics_record(STAGE_ACCEPT_TO_FIRST_BYTE, conn->last_read_ns - conn->accepted_ns);
+        conn->accepted_ns = 0;
+    }
+    conn->in_len += n;
+    conn->in_buf[conn->in_len] = '\0';
+}
+
+// Drain the socket (edge-triggered: read until EAGAIN)
+// Returns 1 if it stopped because in_buf was full, so more data may be waiting
+int handle_read(Connection *conn) {
+    while (!conn->peer_closed) {
+        if (!conn->in_buf && (conn->in_buf = buffer_pool_get(&receive_pool)) == NULL) {
+            perror("Receive buffer allocation failure");
+            conn->state = CONN_CLOSING;
+            break;
+        }
+        size_t space = REQUEST_BUFFER_SIZE - 1 - conn->in_len;
+        if (space == 0) {
+            return 1;
+        }
+        ssize_t bytes_read = read(conn->fd, conn->in_buf + conn->in_len, space);
+        if (bytes_read > 0) {
+            note_bytes_read(conn, bytes_read);
+        } else if (bytes_read == 0) {
+            conn->peer_closed = 1;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        } else {
+            perror("Read Failure");
+            conn->state = CONN_CLOSING;
+            break;
+        }
+    }
+    return 0;
+}
+
+// written bytes of the header iovecs went out: skip past fully written
+// iovecs and trim a partially written one; SENDING_BODY once all are out
+static void advance_iov(Connection *conn, size_t written) {
+    metrics_add(&metrics_shard->bytes_sent, written);
+    if (conn->first_write_ns == 0 && written > 0) {
+        conn->first_write_ns = metrics_now();
+        metrics_record(STAGE_PARSED_TO_FIRST_WRITE, conn->first_write_ns - conn->batch_parsed_ns);
+    }
+    while (conn->iov_index < conn->iov_count && written >= conn->iov[conn->iov_index].iov_len) {
+        written -= conn->iov[conn->iov_index].iov_len;
+        conn->iov_index++;
+    }
+    if (conn->iov_index < conn->iov_count) {
+        conn->iov[conn->iov_index].iov_base = (char *)conn->iov[conn->iov_index].iov_base + written;
+        conn->iov[conn->iov_index].iov_len -= written;
+    } else {
+        conn->state = CONN_SENDING_BODY;
+    }
+}
+
+// In SENDING_BODY: returns 1 while file bytes [file_offset, file_end) are
+// left to send. Otherwise starts the next part of a multipart/byteranges
+// body (back to SENDING_HEADERS) or completes the batch (READING_HEADERS
+// or CLOSING), and returns 0
+static int body_step(Connection *conn) {
+    if (conn->file_fd >= 0 && conn->file_offset < conn->file_end) {
+        return 1;
+    }
+    if (conn->file_fd >= 0 && conn->range_part_index < conn->range_part_count) {
+        // Next part: its boundary and headers, then its byte range
+        RangePart *part = &conn->range_parts[conn->range_part_index++];
+        conn->iov[0].iov_base = part->header;
+        conn->iov[0].iov_len = part->header_len;
+        conn->iov_count = 1;
+        conn->iov_index = 0;
+        conn->file_offset = part->start;
+        conn->file_end = part->end;
+        conn->state = CONN_SENDING_HEADERS;
+        return 0;
+    }
+    // Batch complete
+    uint64_t now = metrics_now();
+    metrics_record(STAGE_FIRST_WRITE_TO_DONE, now - conn->first_write_ns);
+    metrics_record(STAGE_REQUEST_TOTAL, now - conn->batch_start_ns);
+    reset_batch(conn);
+    conn->state = conn->keep_alive ? CONN_READING_HEADERS : CONN_CLOSING;
+    return 0;
+}
+
+// Write as much of the staged batch as the socket will take
+// Returns to CONN_READING_HEADERS (keep-alive) or CONN_CLOSING when done
+void handle_write(Connection *conn) {
+    // A multipart/byteranges body goes back to SENDING_HEADERS for each part
+    while (conn->state == CONN_SENDING_HEADERS || conn->state == CONN_SENDING_BODY) {
+        while (conn->state == CONN_SENDING_HEADERS) {
+            // MSG_MORE holds the headers back so they share a packet with the first sendfile segment
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = conn->iov + conn->iov_index;
+            msg.msg_iovlen = conn->iov_count - conn->iov_index;
+            int flags = conn->file_fd >= 0 && conn->file_offset < conn->file_end ? MSG_MORE : 0;
+            ssize_t written = sendmsg(conn->fd, &msg, flags);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    perror("Header write failure");
+                    conn->state = CONN_CLOSING;
+                }
+                return;  // Wait for EPOLLOUT
+            }
+            advance_iov(conn, written);
+        }
+
+        while (conn->state == CONN_SENDING_BODY && body_step(conn)) {
+            // Zero-copy: the kernel moves page cache pages straight to the socket
+            ssize_t written = sendfile(conn->fd, conn->file_fd, &conn->file_offset,
+                                       conn->file_end - conn->file_offset);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    perror("File content write failure");
+                    conn->state = CONN_CLOSING;
+                }
+                return;  // Partial send: file_offset already records progress
+            }
+            metrics_add(&metrics_shard->bytes_sent, written);
+            if (written == 0) {
+                fprintf(stderr, "File truncated while sending\n");
+                conn->state = CONN_CLOSING;
+            }
+        }
+    }
+}
+
+// Free a closed connection's batch, buffers and memory
+static void release_connection(Connection *conn) {
+    reset_batch(conn);
+    buffer_pool_put(&receive_pool, conn->in_buf);
+    if (conn->pipe_fds[0] >= 0) {
+        close(conn->pipe_fds[0]);
+        close(conn->pipe_fds[1]);
+    }
+    buffer_pool_put(&connection_pool, conn);
+}
+
+void close_connection(Connection *conn) {
+    // Unread request bytes make close() send a reset, which can destroy an
+    // error response the client has not read yet - drain what is queued first
+    if (!conn->peer_closed) {
+        char drain[BUFFER_SIZE];
+        shutdown(conn->fd, SHUT_WR);
+        for (int i = 0; i < 16 && recv(conn->fd, drain, sizeof(drain), MSG_DONTWAIT) > 0; i++) {
+        }
+    }
+    // io_uring operations still in flight complete (with an error) once the
+    // socket is shut down; they reference the batch until then
+    int in_flight = conn->recv_pending + conn->send_pending;
+    if (in_flight > 0) {
+        shutdown(conn->fd, SHUT_RDWR);
+    }
+    close(conn->fd);  // Also removes it from the epoll set
+    conn->fd = -1;
+    timer_wheel_cancel(&timers, &conn->timer);
+    if (conn->file_load) {
+        conn->file_load->conn = NULL;  // file_load_done() still caches the file
+    }
+    if (in_flight == 0) {
+        release_connection(conn);
+    }
+    active_connections--;
+    metrics_add(&metrics_shard->connections_active, (uint64_t)-1);
+}
+
+// Set up the Connection of an accepted socket
+// Returns NULL (and closes the socket) if there is no memory for it
+static Connection *connection_open(int client_fd, const struct sockaddr_in *client_addr) {
+    Connection *conn = buffer_pool_get(&connection_pool);
+    if (!conn) {
+        perror("Connection allocation failure");
+        close(client_fd);
+        return NULL;
+    }
+    memset(conn, 0, sizeof(*conn));
+    conn->accepted_ns = metrics_now();
+    conn->fd = client_fd;
+    conn->file_fd = -1;
+    conn->pipe_fds[0] = conn->pipe_fds[1] = -1;
+    conn->keep_alive = 1;
+    conn->vhost = &default_host;
+    conn->state = CONN_READING_HEADERS;
+    http_parser_init(&conn->parser);
+    inet_ntop(AF_INET, &client_addr->sin_addr, conn->client_ip, sizeof(conn->client_ip));
+    conn->client_port = ntohs(client_addr->sin_port);
+    return conn;
+}
+
+// Accept every pending connection (edge-triggered listener)
+void accept_connections(int epoll_fd, int server_fd) {
+    while (1) {
+        struct sockaddr_in client_addr;
+        socklen_t client_len = sizeof(client_addr);
+        int client_fd = accept4(server_fd, (struct sockaddr *)&client_addr, &client_len, SOCK_NONBLOCK);
+        if (client_fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                perror("Accept Failure");
+            }
+            return;
+        }
+
+        Connection *conn = connection_open(client_fd, &client_addr);
+        if (!conn) {
+            continue;
+        }
+
+        // One registration for the whole lifetime: edge-triggered read + write
+        struct epoll_event event;
+        event.events = EPOLLIN | EPOLLOUT | EPOLLET;
+        event.data.ptr = conn;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client_fd, &event) < 0) {
+            perror("epoll_ctl add client failure");
+            close(client_fd);
+            buffer_pool_put(&connection_pool, conn);
+            continue;
+        }
+        active_connections++;
+        metrics_add(&metrics_shard->connections_accepted, 1);
+        metrics_add(&metrics_shard->connections_active, 1);
+        arm_read_timeout(conn);
+    }
+}
+
+// Advance one connection's state machine until it has to wait for I/O
+void handle_connection_event(Connection *conn, uint32_t events) {
+    if (events & (EPOLLERR | EPOLLHUP)) {
+        close_connection(conn);
+        return;
+    }
+    while (1) {
+        if (conn->state == CONN_WAITING_FILE) {
+            return;  // Input stays in the socket until file_load_done() resumes it
+        }
+        if (conn->state == CONN_READING_HEADERS) {
+            int buffer_was_full = handle_read(conn);
+            if (conn->state == CONN_READING_HEADERS) {
+                process_pipeline(conn);
+            }
+            if (conn->state == CONN_READING_HEADERS) {
+                if (buffer_was_full && conn->in_len < REQUEST_BUFFER_SIZE - 1) {
+                    continue;  // Made room - read what is still queued in the socket
+                }
+                arm_read_timeout(conn);
+                return;  // Wait for more of the request
+            }
+        }
+        if (conn->state == CONN_SENDING_HEADERS || conn->state == CONN_SENDING_BODY) {
+            handle_write(conn);
+            if (conn->state == CONN_SENDING_HEADERS || conn->state == CONN_SENDING_BODY) {
+                return;  // Socket full - wait for EPOLLOUT
+            }
+        }
+        if (conn->state == CONN_CLOSING) {
+            close_connection(conn);
+            return;
+        }
+        // Back to READING_HEADERS: answer any pipelined requests already buffered
+    }
+}
+
+// io_uring backend
+//
+// The same connection state machine as handle_connection_event(), driven
+// by completions instead of readiness: the listener has one multishot
+// accept, a reading connection one recv that takes a provided buffer when
+// data arrives, and a sending connection a sendmsg of its batch, linked
+// for a large body to a splice from the file into the connection's pipe
+// and one from the pipe to the socket. Everything prepared during a loop
+// iteration is submitted by the io_uring_enter() that waits for the next
+// completions. user_data is the Connection pointer with the operation in
+// its low bits, or one of the markers for the listener and helper fds.
+
+#define URING_RECV 1
+#define URING_SEND 2
+#define URING_SPLICE_IN 3
+#define URING_SPLICE_OUT 4
+#define URING_OP_MASK 7
+
+static uint64_t uring_data(Connection *conn, int op) {
+    return (uint64_t)(uintptr_t)conn | op;
+}
+
+static struct io_uring_sqe *uring_sqe(void) {
+    struct io_uring_sqe *sqe = uring_get_sqe(&uring);
+    if (!sqe) {
+        perror("io_uring submission failure");
+    }
+    return sqe;
+}
+
+// Receive into in_buf, at most what fits
+static void uring_arm_recv(Connection *conn) {
+    size_t room = REQUEST_BUFFER_SIZE - 1 - conn->in_len;
+    if (conn->recv_pending || conn->peer_closed || room == 0) {
+        return;
+    }
+    struct io_uring_sqe *sqe = uring_sqe();
+    if (!sqe) {
+        conn->state = CONN_CLOSING;
+        return;
+    }
+    uring_prep_recv_select(sqe, conn->fd, room < URING_BUFFER_SIZE ? room : URING_BUFFER_SIZE,
+                           uring.buf_group, uring_data(conn, URING_RECV));
+    conn->recv_pending = 1;
+}
+
+// Queue the next chunk of the body: file -> pipe, linked to pipe -> socket
+// (the link is cut if the first splice comes up short; uring_send() then
+// flushes what reached the pipe)
+static int uring_queue_splice(Connection *conn) {
+    if (conn->pipe_fds[0] < 0 && pipe2(conn->pipe_fds, O_CLOEXEC) < 0) {
+        perror("Pipe failure");
+        conn->pipe_fds[0] = conn->pipe_fds[1] = -1;
+        return -1;
+    } else if (conn->pipe_size == 0) {
+        // Larger pipes need fewer round trips; past the per-user pipe
+        // allowance the kernel refuses and the default 64 KB stays
+        int size = fcntl(conn->pipe_fds[1], F_SETPIPE_SZ, SPLICE_PIPE_SIZE);
+        if (size < 0) {
+            size = fcntl(conn->pipe_fds[1], F_GETPIPE_SZ);
+        }
+        conn->pipe_size = size > 0 ? (size_t)size : 4096;
+    }
+    if (uring_reserve(&uring, 2) < 0) {
+        perror("io_uring submission failure");
+        return -1;
+    }
+    off_t left = conn->file_end - conn->file_offset;
+    size_t chunk = (size_t)left < conn->pipe_size ? (size_t)left : conn->pipe_size;
+    struct io_uring_sqe *sqe = uring_get_sqe(&uring);
+    uring_prep_splice(sqe, conn->file_fd, conn->file_offset, conn->pipe_fds[1], chunk,
+                      uring_data(conn, URING_SPLICE_IN));
+    sqe->flags |= IOSQE_IO_LINK;
+    sqe = uring_get_sqe(&uring);
+    uring_prep_splice(sqe, conn->pipe_fds[0], -1, conn->fd, chunk, uring_data(conn, URING_SPLICE_OUT));
+    conn->send_pending += 2;
+    return 0;
+}
+
+// Start the next send of the batch (nothing of it is in flight)
+static void uring_send(Connection *conn) {
+    if (conn->pipe_bytes > 0) {
+        struct io_uring_sqe *sqe = uring_sqe();
+        if (!sqe) {
+            conn->state = CONN_CLOSING;
+            return;
+        }
+        uring_prep_splice(sqe, conn->pipe_fds[0], -1, conn->fd, conn->pipe_bytes,
+                          uring_data(conn, URING_SPLICE_OUT));
+        conn->send_pending++;
+        return;
+    }
+    while (conn->state == CONN_SENDING_HEADERS || conn->state == CONN_SENDING_BODY) {
+        if (conn->state == CONN_SENDING_BODY) {
+            if (!body_step(conn)) {
+                continue;  // Next multipart part, or the batch is done
+            }
+            if (uring_queue_splice(conn) < 0) {
+                conn->state = CONN_CLOSING;
+            }
+            return;
+        }
+        // The body's first chunk is linked behind the headers; MSG_WAITALL
+        // makes a short header send cut the link instead of splicing early
+        int body = conn->file_fd >= 0 && conn->file_offset < conn->file_end;
+        if (uring_reserve(&uring, body ? 3 : 1) < 0) {
+            perror("io_uring submission failure");
+            conn->state = CONN_CLOSING;
+            return;
+        }
+        memset(&conn->msg, 0, sizeof(conn->msg));
+        conn->msg.msg_iov = conn->iov + conn->iov_index;
+        conn->msg.msg_iovlen = conn->iov_count - conn->iov_index;
+        struct io_uring_sqe *sqe = uring_get_sqe(&uring);
+        uring_prep_sendmsg(sqe, conn->fd, &conn->msg, body ? MSG_MORE | MSG_WAITALL : 0,
+                           uring_data(conn, URING_SEND));
+        conn->send_pending++;
+        if (body) {
+            sqe->flags |= IOSQE_IO_LINK;
+            if (uring_queue_splice(conn) < 0) {
+                sqe->flags &= ~IOSQE_IO_LINK;  // The headers go alone; the body is retried after them
+            }
+        }
+        return;
+    }
+}
+
+// Advance a connection until it waits for a completion
+static void uring_drive(Connection *conn) {
+    while (conn->fd >= 0) {
+        if (conn->state == CONN_WAITING_FILE) {
+            return;  // Resumed by file_load_done()
+        }
+        if (conn->state == CONN_READING_HEADERS) {
+            process_pipeline(conn);
+            if (conn->state == CONN_READING_HEADERS) {
+                arm_read_timeout(conn);
+                uring_arm_recv(conn);
+                if (conn->state == CONN_READING_HEADERS) {
+                    return;  // Wait for more of the request
+                }
+            }
+            continue;
+        }
+        if (conn->state == CONN_SENDING_HEADERS || conn->state == CONN_SENDING_BODY) {
+            if (conn->send_pending == 0) {
+                uring_send(conn);
+            }
+            if (conn->send_pending > 0) {
+                return;  // Wait for the send to complete
+            }
+            continue;
+        }
+        close_connection(conn);  // CONN_CLOSING
+        return;
+    }
+}
+
+// One completion for a connection
+static void uring_connection_done(Connection *conn, int op, const struct io_uring_cqe *cqe) {
+    int res = cqe->res;
+    int open = conn->fd >= 0;
+    if (op == URING_RECV) {
+        conn->recv_pending = 0;
+        if (res > 0) {
+            unsigned bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+            if (open && !conn->in_buf && (conn->in_buf = buffer_pool_get(&receive_pool)) == NULL) {
+                perror("Receive buffer allocation failure");
+                conn->state = CONN_CLOSING;
+            } else if (open) {
+                memcpy(conn->in_buf + conn->in_len, uring_buffer(&uring, bid), res);
+                note_bytes_read(conn, res);
+            }
+            uring_buffer_return(&uring, bid);
+        } else if (res == 0) {
+            conn->peer_closed = 1;
+        } else if (res != -ENOBUFS && open) {  // Out of buffers: receive again below
+            errno = -res;
+            perror("Read Failure");
+            conn->state = CONN_CLOSING;
+        }
+    } else {
+        conn->send_pending--;
+        if (res < 0 && res != -ECANCELED && open) {
+            errno = -res;
+            perror(op == URING_SEND ? "Header write failure" : "File content write failure");
+            conn->state = CONN_CLOSING;
+        } else if (res > 0 && open && op == URING_SEND) {
+            advance_iov(conn, res);
+        } else if (res > 0 && op == URING_SPLICE_IN) {
+            conn->file_offset += res;
+            conn->pipe_bytes += res;
+        } else if (res > 0) {
+            conn->pipe_bytes -= res;
+            metrics_add(&metrics_shard->bytes_sent, res);
+        } else if (res == 0 && op != URING_SEND && open) {
+            fprintf(stderr, "File truncated while sending\n");
+            conn->state = CONN_CLOSING;
+        }
+    }
+
+    if (!open) {
+        if (conn->recv_pending + conn->send_pending == 0) {
+            release_connection(conn);
+        }
+        return;
+    }
+    // Input only moves the state machine while reading; a send only once
+    // all of its linked operations are back
+    if ((op == URING_RECV && conn->state != CONN_SENDING_HEADERS && conn->state != CONN_SENDING_BODY) ||
+        (op != URING_RECV && conn->send_pending == 0)) {
+        uring_drive(conn);
+    }
+}
+
+static void uring_arm_accept(int server_fd) {
+    struct io_uring_sqe *sqe = uring_sqe();
+    if (sqe) {
+        uring_prep_accept_multishot(sqe, server_fd, (uintptr_t)&listener_marker);
+    }
+}
+
+// A connection from the multishot accept
+static void uring_accept_done(int server_fd, const struct io_uring_cqe *cqe) {
+    if (cqe->res >= 0) {
+        // Multishot accept has nowhere to put each peer address
+        struct sockaddr_in client_addr;
+        socklen_t client_len = sizeof(client_addr);
+        if (getpeername(cqe->res, (struct sockaddr *)&client_addr, &client_len) < 0) {
+            memset(&client_addr, 0, sizeof(client_addr));
+        }
+        Connection *conn = connection_open(cqe->res, &client_addr);
+        if (conn) {
+            active_connections++;
+            metrics_add(&metrics_shard->connections_accepted, 1);
+            metrics_add(&metrics_shard->connections_active, 1);
+            arm_read_timeout(conn);
+            uring_arm_recv(conn);
+        }
+    } else {
+        errno = -cqe->res;
+        perror("Accept Failure");
+    }
+    if (!(cqe->flags & IORING_CQE_F_MORE)) {
+        uring_arm_accept(server_fd);
+    }
+}
+
+// Watch a helper's fd (inotify, compressor, I/O pool) with a multishot poll
+static void uring_arm_poll(int fd, void *marker) {
+    struct io_uring_sqe *sqe = fd >= 0 ? uring_sqe() : NULL;
+    if (sqe) {
+        uring_prep_poll_multishot(sqe, fd, POLLIN, (uintptr_t)marker);
+    }
+}
+
+// Continue a connection's state machine outside of an I/O event
+static void resume_connection(Connection *conn) {
+    if (uring_active) {
+        uring_drive(conn);
+    } else {
+        handle_connection_event(conn, 0);
+    }
+}
+
+// An I/O pool load finished (see thread_pool_collect): cache the file and
+// run the request that waited for it again
+void file_load_done(PoolTask *task) {
+    FileLoad *load = (FileLoad *)task;
+    FileCacheEntry *entry = file_cache_build(load->path, &load->result);
+    int saved_errno = errno;
+    if (entry) {
+        // A file invalidated while it was being opened may have been opened
+        // before it changed: good for this request, but not for the cache
+        if (load->generation == file_cache.invalidations) {
+            entry = file_cache_insert(load->partition, entry);
+        } else {
+            entry->refcount = 1;
+        }
+    }
+    Connection *conn = load->conn;
+    counted_free(load);
+    if (!conn) {
+        if (entry) {
+            file_cache_release(entry);
+        }
+        return;
+    }
+    conn->file_load = NULL;
+    conn->file_loaded = 1;
+    conn->loaded_entry = entry;
+    conn->loaded_errno = saved_errno;
+    conn->state = CONN_READING_HEADERS;
+    resume_connection(conn);
+}
+
+// A connection missed its deadline (see arm_read_timeout)
+void connection_timed_out(Timer *timer) {
+    Connection *conn = (Connection *)((char *)timer - offsetof(Connection, timer));
+    debug_log(1, "%s:%d %s timeout\n", conn->client_ip, conn->client_port, timeout_names[conn->timeout_kind]);
+    if (conn->timeout_kind == TIMEOUT_HEADER && conn->state == CONN_READING_HEADERS &&
+        conn->in_len > 0 && conn->response_count == 0) {
+        // Part of a request arrived: say why before closing, and give the
+        // 408 as long as the head had to get out
+        note_request_parsed(conn);
+        conn->keep_alive = 0;
+        send_error_response(conn, 408, "Request Timeout");
+        conn->state = CONN_SENDING_HEADERS;
+        arm_timeout(conn, TIMEOUT_REQUEST, current_tick, config.header_timeout);
+        resume_connection(conn);
+        return;
+    }
+    close_connection(conn);
+}
+
+// Create, bind and listen on a non-blocking TCP socket
+// With reuseport each worker gets its own socket and the kernel load-balances between them
+int create_server_socket(int port, int backlog, int reuseport) {
+    int opt = 1;
+    struct sockaddr_in server_addr;
+
+    int server_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (server_fd < 0) {
+        perror("Socket creation failed");
+        return -1;
+    }
+    if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
+        perror("Set socket options failed");
+        close(server_fd);
+        return -1;
+    }
+    if (reuseport && setsockopt(server_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+        perror("Set SO_REUSEPORT failed");
+        close(server_fd);
+        return -1;
+    }
+    // Setup server address structure
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_addr.s_addr = INADDR_ANY;
+    server_addr.sin_port = htons(port);
+
+    if (bind(server_fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
+        perror("Bind Failure");
+        close(server_fd);
+        return -1;
+    }
+    if (listen(server_fd, backlog) < 0) {
+        perror("listen Failure");
+        close(server_fd);
+        return -1;
+    }
+    return server_fd;
+}
+
+// Statistics (SIGUSR1) and reloads (SIGHUP) asked for since the last loop iteration
+static void handle_signal_requests(void) {
+    if (stats_requested) {
+        stats_requested = 0;
+        print_cache_stats();
+        print_memory_stats();
+        if (access_log_enabled()) {
+            printf("Access log (pid %d): %lu records queued, %lu dropped\n",
+                   getpid(), access_log_written(), access_log_dropped());
+        }
+        if (uring_active) {
+            printf("io_uring (pid %d): %lu io_uring_enter calls\n", getpid(), uring.enters);
+        }
+        fflush(stdout);
+    }
+    if (reload_requested) {
+        reload_requested = 0;
+        load_error_pages();
+        file_cache_invalidate_prefix(NULL);
+        printf("Reloaded error pages and flushed file cache (pid %d)\n", getpid());
+        fflush(stdout);
+    }
+}
+
+// Readiness-driven loop on epoll: runs on server_fd until a fatal error
+static int run_epoll_loop(int server_fd) {
+    int epoll_fd = epoll_create1(0);
+    if (epoll_fd < 0) {
+        perror("epoll_create1 failure");
+        return -1;
+    }
+    // Connections carry their Connection pointer; other fds carry a marker
+    struct epoll_event listen_event;
+    listen_event.events = EPOLLIN | EPOLLET;
+    listen_event.data.ptr = &listener_marker;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, server_fd, &listen_event) < 0) {
+        perror("epoll_ctl add listener failure");
+        close(epoll_fd);
+        return -1;
+    }
+    int helper_fds[] = { inotify_fd, compress_fd, io_pool_fd };
+    void *helper_markers[] = { &inotify_marker, &compress_marker, &io_pool_marker };
+    for (int i = 0; i < 3; i++) {
+        struct epoll_event helper_event;
+        helper_event.events = EPOLLIN | EPOLLET;
+        helper_event.data.ptr = helper_markers[i];
+        if (helper_fds[i] >= 0 && epoll_ctl(epoll_fd, EPOLL_CTL_ADD, helper_fds[i], &helper_event) < 0) {
+            perror("epoll_ctl add helper failure");
+        }
+    }
+    printf("Connections driven by epoll (pid %d)\n", getpid());
+    fflush(stdout);
+
+    struct epoll_event events[MAX_EVENTS];
+    while (1) {
+        // Wake every tick while any deadline is armed
+        int ready = epoll_wait(epoll_fd, events, MAX_EVENTS, timers.armed ? TIMER_TICK_MS : -1);
+        int wait_errno = errno;  // A reload below opens files and can overwrite it
+        server_clock_update();
+        current_tick = ns_to_tick(metrics_now());
+        handle_signal_requests();
+        if (ready < 0) {
+            if (wait_errno == EINTR) {
+                continue;
+            }
+            errno = wait_errno;
+            perror("epoll_wait failure");
+            break;
+        }
+        for (int i = 0; i < ready; i++) {
+            if (events[i].data.ptr == &listener_marker) {
+                accept_connections(epoll_fd, server_fd);
+            } else if (events[i].data.ptr == &inotify_marker) {
+                handle_file_events();
+            } else if (events[i].data.ptr == &compress_marker) {
+                compress_collect(compress_done);
+            } else if (events[i].data.ptr == &io_pool_marker) {
+                thread_pool_collect(file_load_done);
+            } else {
+                handle_connection_event(events[i].data.ptr, events[i].events);
+            }
+        }
+        timer_wheel_advance(&timers, current_tick, connection_timed_out);
+        if (config.verbosity > 0) {
+            fflush(stdout);
+        }
+    }
+
+    close(epoll_fd);
+    return -1;
+}
+
+// Completion-driven loop on io_uring (see uring_drive)
+// Returns -1 at once, with errno set, if io_uring cannot be set up here
+static int run_uring_loop(int server_fd) {
+    if (uring_init(&uring, URING_ENTRIES) < 0) {
+        return -1;
+    }
+    if (uring_setup_buffers(&uring, 0, URING_BUFFERS, URING_BUFFER_SIZE) < 0) {
+        int saved_errno = errno;
+        uring_exit(&uring);
+        errno = saved_errno;
+        return -1;
+    }
+    uring_active = 1;
+    uring_arm_accept(server_fd);
+    uring_arm_poll(inotify_fd, &inotify_marker);
+    uring_arm_poll(compress_fd, &compress_marker);
+    uring_arm_poll(io_pool_fd, &io_pool_marker);
+    printf("Connections driven by io_uring (pid %d)\n", getpid());
+    fflush(stdout);
+
+    while (1) {
+        // One system call submits everything queued and waits for completions
+        if (uring_submit_and_wait(&uring, timers.armed ? TIMER_TICK_MS : -1) < 0 && errno != EINTR) {
+            perror("io_uring_enter failure");
+            break;
+        }
+        server_clock_update();
+        current_tick = ns_to_tick(metrics_now());
+        handle_signal_requests();
+        struct io_uring_cqe *next;
+        while ((next = uring_peek_cqe(&uring)) != NULL) {
+            struct io_uring_cqe cqe = *next;
+            uring_cqe_seen(&uring);
+            void *marker = (void *)(uintptr_t)cqe.user_data;
+            if (marker == &listener_marker) {
+                uring_accept_done(server_fd, &cqe);
+                continue;
+            }
+            if (marker == &inotify_marker || marker == &compress_marker || marker == &io_pool_marker) {
+                if (marker == &inotify_marker) {
+                    handle_file_events();
+                } else if (marker == &compress_marker) {
+                    compress_collect(compress_done);
+                } else {
+                    thread_pool_collect(file_load_done);
+                }
+                if (!(cqe.flags & IORING_CQE_F_MORE)) {
+                    uring_arm_poll(marker == &inotify_marker ? inotify_fd :
+                                   marker == &compress_marker ? compress_fd : io_pool_fd, marker);
+                }
+                continue;
+            }
+            Connection *conn = (Connection *)(uintptr_t)(cqe.user_data & ~(uint64_t)URING_OP_MASK);
+            uring_connection_done(conn, cqe.user_data & URING_OP_MASK, &cqe);
+        }
+        timer_wheel_advance(&timers, current_tick, connection_timed_out);
+        if (config.verbosity > 0) {
+            fflush(stdout);
+        }
+    }
+    return -1;
+}
+
+int run_event_loop(int server_fd) {
+    // The writer thread belongs to this process (a worker, after fork)
+    if (access_log_start() < 0) {
+        perror("Access log writer failure");
+    }
+    // Cached files are invalidated as soon as they change on disk (an
+    // asset pack never changes and needs none of these helpers)
+    if (config.cache_entries > 0 && !asset_pack.base) {
+        file_watch_init();
+    }
+    // Files too large to gzip on the event loop go to the compressor thread
+    if (config.cache_entries > 0 && config.compress_max > config.compress_inline && !asset_pack.base) {
+        compress_fd = compress_start();
+    }
+    // Cache misses are opened on the I/O pool, so a slow disk only holds up
+    // the requests that need it
+    if (config.io_threads > 0 && !asset_pack.base && (io_pool_fd = thread_pool_start(config.io_threads)) < 0) {
+        perror("I/O pool failure");
+    }
+
+    server_clock_update();
+    current_tick = ns_to_tick(metrics_now());
+    timer_wheel_init(&timers, current_tick);
+    if (config.io_uring) {
+        run_uring_loop(server_fd);
+        if (uring_active) {
+            return -1;
+        }
+        fprintf(stderr, "io_uring unavailable (%s), using epoll\n", strerror(errno));
+    }
+    return run_epoll_loop(server_fd);
+}
+
+// Body of a worker process: own SO_REUSEPORT socket, optional CPU pinning
+void run_worker(int worker_id) {
+    metrics_select_shard(worker_id);
+
+    if (config.pin_cpus) {
+        long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        CPU_SET(worker_id % (cpu_count > 0 ? cpu_count : 1), &cpu_set);
+        if (sched_setaffinity(0, sizeof(cpu_set), &cpu_set) < 0) {
+            perror("CPU pinning failed");
+        }
+    }
+
+    int server_fd = create_server_socket(config.port, config.backlog, 1);
+    if (server_fd < 0) {
+        exit(EXIT_FAILURE);
+    }
+    printf("Worker %d (pid %d) accepting on port %d\n", worker_id, getpid(), config.port);
+    fflush(stdout);
+    run_event_loop(server_fd);
+    close(server_fd);
+    exit(EXIT_FAILURE);
+}
+
+static volatile sig_atomic_t shutdown_requested = 0;
+
+void handle_shutdown_signal(int signo) {
+    (void)signo;
+    shutdown_requested = 1;
+}
+
+// SIGUSR1: print cache statistics from the event loop
+void handle_stats_signal(int signo) {
+    (void)signo;
+    stats_requested = 1;
+}
+
+// SIGHUP: reload error pages and drop every cached file
+void handle_reload_signal(int signo) {
+    (void)signo;
+    reload_requested = 1;
+}
+
+// Fork one worker into slot worker_id
+// SIGINT/SIGTERM stay blocked until the child has its own handlers, so a
+// shutdown that races the fork still reaches the new worker
+pid_t spawn_worker(int worker_id) {
+    sigset_t shutdown_signals, saved;
+    sigemptyset(&shutdown_signals);
+    sigaddset(&shutdown_signals, SIGINT);
+    sigaddset(&shutdown_signals, SIGTERM);
+    sigprocmask(SIG_BLOCK, &shutdown_signals, &saved);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("Fork worker failed");
+    } else if (pid == 0) {
+        signal(SIGINT, SIG_DFL);
+        signal(SIGTERM, SIG_DFL);
+        sigprocmask(SIG_SETMASK, &saved, NULL);
+        run_worker(worker_id);
+    }
+    sigprocmask(SIG_SETMASK, &saved, NULL);
+    return pid;
+}
+
+// Signal every live worker (not kill(-1, ...) for a slot whose fork failed)
+static void forward_signal(const pid_t *workers, int signo) {
+    for (int i = 0; i < config.workers; i++) {
+        if (workers[i] > 0) {
+            kill(workers[i], signo);
+        }
+    }
+}
+
+// Master process: start the workers and restart any that die
+void run_master(void) {
+    pid_t *workers = counted_calloc(config.workers, sizeof(pid_t));
+    time_t *started = counted_calloc(config.workers, sizeof(time_t));
+    if (!workers || !started) {
+        perror("Worker table allocation failed");
+        exit(EXIT_FAILURE);
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_shutdown_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    fflush(stdout);  // Don't duplicate buffered output into the children
+    for (int i = 0; i < config.workers; i++) {
+        workers[i] = spawn_worker(i);
+        started[i] = time(NULL);
+    }
+
+    while (!shutdown_requested) {
+        // Retry the slots whose fork failed, at most once a second; no
+        // child exists for them, so nothing would ever be reaped to do it
+        int missing = 0;
+        for (int i = 0; i < config.workers; i++) {
+            if (workers[i] <= 0 && time(NULL) - started[i] >= 1 && !shutdown_requested) {
+                workers[i] = spawn_worker(i);
+                started[i] = time(NULL);
+            }
+            missing |= workers[i] <= 0;
+        }
+        // Each worker has its own caches - pass requests on to all of them,
+        // each on its own so a SIGUSR1 and a SIGHUP that arrive together both go
+        if (stats_requested) {
+            stats_requested = 0;
+            forward_signal(workers, SIGUSR1);
+        }
+        if (reload_requested) {
+            reload_requested = 0;
+            forward_signal(workers, SIGHUP);
+        }
+        int status;
+        pid_t pid = missing ? waitpid(-1, &status, WNOHANG) : wait(&status);
+        if (pid == 0 || (pid < 0 && errno == ECHILD && missing)) {
+            sleep(1);  // Nothing to reap yet; retry the missing workers
+            continue;
+        }
+        if (pid < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("wait failure");
+            break;
+        }
+        for (int i = 0; i < config.workers; i++) {
+            if (workers[i] != pid) {
+                continue;
+            }
+            if (WIFSIGNALED(status)) {
+                printf("Worker %d (pid %d) killed by signal %d, restarting\n", i, pid, WTERMSIG(status));
+            } else {
+                printf("Worker %d (pid %d) exited with status %d, restarting\n", i, pid, WEXITSTATUS(status));
+            }
+            fflush(stdout);
+            // Throttle a worker that dies right after starting (e.g. port in use)
+            if (time(NULL) - started[i] < 1) {
+                sleep(1);
+            }
+            workers[i] = shutdown_requested ? 0 : spawn_worker(i);
+            started[i] = time(NULL);
+        }
+    }
+
+    printf("Shutting down %d workers\n", config.workers);
+    for (int i = 0; i < config.workers; i++) {
+        if (workers[i] > 0) {
+            kill(workers[i], SIGTERM);
+        }
+    }
+    while (wait(NULL) > 0 || errno == EINTR) {
+    }
+    counted_free(workers);
+    counted_free(started);
+}
+
+// A directory the way the asset pack stores paths ("./dir", no trailing
+// '/'), so packed files are found under it too; -1 if it does not fit
+static int normalize_dir(char *buf, size_t size, const char *dir, const char *subdir) {
+    int relative = dir[0] != '/' && strncmp(dir, "./", 2) != 0;
+    int len = snprintf(buf, size, "%s%s", relative ? "./" : "", dir);
+    while (len > 1 && len < (int)size && buf[len - 1] == '/') {
+        buf[--len] = '\0';
+    }
+    if (len < (int)size && subdir) {
+        len += snprintf(buf + len, size - len, "/%s", subdir);
+    }
+    return dir[0] != '\0' && len < (int)size ? 0 : -1;
+}
+
+// Add a static mount
+static int add_mount(const char *prefix, size_t prefix_len, const char *dir) {
+    if (config.mount_count == MAX_MOUNTS || prefix_len == 0 || prefix[0] != '/' || prefix[prefix_len - 1] != '/' ||
+        memchr(prefix, ':', prefix_len) || memchr(prefix, '*', prefix_len)) {
+        return -1;
+    }
+    StaticMount *mount = &config.mounts[config.mount_count];
+    if (normalize_dir(mount->root, sizeof(mount->root), dir, NULL) < 0 ||
+        snprintf(mount->pattern, sizeof(mount->pattern), "%.*s*path", (int)prefix_len, prefix) >=
+            (int)sizeof(mount->pattern)) {
+        return -1;
+    }
+    mount->prefix_len = prefix_len;
+    config.mount_count++;
+    return 0;
+}
+
+// Add a virtual host serving dir/public and dir/errors: a host name, or
+// "*.domain" for every name below domain
+static int add_vhost(const char *host, size_t host_len, const char *dir) {
+    if (host_len > 2 && host[0] == '*' && host[1] == '.') {
+        host++;
+        host_len--;  // Stored as ".domain", which no Host can be
+    }
+    if (host_len == 0 || host_len >= sizeof(vhosts->name) || memchr(host, '*', host_len) ||
+        memchr(host, '/', host_len) || host[host_len - 1] == '.') {
+        return -1;
+    }
+    if (vhost_count == vhost_capacity) {
+        int capacity = vhost_capacity ? vhost_capacity * 2 : 16;
+        VirtualHost *grown = realloc(vhosts, capacity * sizeof(VirtualHost));
+        if (!grown) {
+            return -1;
+        }
+        vhosts = grown;
+        vhost_capacity = capacity;
+    }
+    VirtualHost *vhost = &vhosts[vhost_count];
+    memset(vhost, 0, sizeof(*vhost));
+    for (size_t i = 0; i < host_len; i++) {
+        vhost->name[i] = host[i] >= 'A' && host[i] <= 'Z' ? host[i] + ('a' - 'A') : host[i];
+    }
+    snprintf(vhost->mount.pattern, sizeof(vhost->mount.pattern), "/*path");
+    vhost->mount.prefix_len = 1;
+    if (normalize_dir(vhost->mount.root, sizeof(vhost->mount.root), dir, "public") < 0 ||
+        normalize_dir(vhost->errors, sizeof(vhost->errors), dir, "errors") < 0) {
+        return -1;
+    }
+    vhost_count++;
+    return 0;
+}
+
+// Add the virtual hosts of a sites file: "host dir" per line, # comments
+static int load_vhosts(const char *file_name) {
+    FILE *file = fopen(file_name, "r");
+    if (!file) {
+        perror(file_name);
+        return -1;
+    }
+    char line[1024];
+    int line_number = 0;
+    while (fgets(line, sizeof(line), file)) {
+        line_number++;
+        line[strcspn(line, "#")] = '\0';
+        char host[256];
+        char dir[256];
+        char extra;
+        int fields = sscanf(line, "%255s %255s %c", host, dir, &extra);
+        if (fields <= 0) {
+            continue;
+        }
+        if (fields != 2 || add_vhost(host, strlen(host), dir) < 0) {
+            fprintf(stderr, "%s:%d: invalid site (expected: host dir)\n", file_name, line_number);
+            fclose(file);
+            return -1;
+        }
+    }
+    fclose(file);
+    return 0;
+}
+
+// Index the virtual hosts by name and split the file cache evenly between
+// the sites (the default one included)
+static int build_vhosts(void) {
+    int sites = vhost_count + 1;
+    for (int site = -1; site < vhost_count; site++) {
+        CachePartition *cache = site < 0 ? &default_host.cache : &vhosts[site].cache;
+        cache->max_entries = (config.cache_entries + sites - 1) / sites;
+        cache->max_memory = config.cache_memory / sites;
+    }
+    if (vhost_count == 0) {
+        return 0;
+    }
+    size_t slots = 2;
+    while (slots < 2 * (size_t)vhost_count) {
+        slots *= 2;
+    }
+    vhost_table = calloc(slots, sizeof(VirtualHost *));
+    if (!vhost_table) {
+        perror("Virtual host table allocation failed");
+        return -1;
+    }
+    vhost_mask = slots - 1;
+    for (int i = 0; i < vhost_count; i++) {
+        size_t slot = hash_path(vhosts[i].name) & vhost_mask;
+        while (vhost_table[slot]) {
+            if (strcmp(vhost_table[slot]->name, vhosts[i].name) == 0) {
+                fprintf(stderr, "Virtual host %s%s defined twice\n", vhosts[i].name[0] == '.' ? "*" : "",
+                        vhosts[i].name);
+                return -1;
+            }
+            slot = (slot + 1) & vhost_mask;
+        }
+        vhost_table[slot] = &vhosts[i];
+    }
+    return 0;
+}
+
+// Route the metrics and health endpoints and every mount; ./public is
+// mounted at / unless -D mounted something there
+static int build_router(void) {
+    router_init(&router);
+    int has_root = 0;
+    for (int i = 0; i < config.mount_count; i++) {
+        has_root |= config.mounts[i].prefix_len == 1;
+    }
+    if (!has_root && add_mount("/", 1, DOCUMENT_ROOT) < 0) {
+        fprintf(stderr, "Too many mounts to add %s at /\n", DOCUMENT_ROOT);
+        return -1;
+    }
+    unsigned get_head = ROUTER_METHOD_BIT(ROUTER_GET) | ROUTER_METHOD_BIT(ROUTER_HEAD);
+    const char *paths[] = { config.metrics_path, config.health_path };
+    RouteHandler handlers[] = { send_metrics_response, send_health_response };
+    for (int i = 0; i < 2; i++) {
+        handler_routes[i].handler = handlers[i];
+        if (paths[i] && router_add(&router, get_head, paths[i], &handler_routes[i]) < 0) {
+            fprintf(stderr, "Cannot route %s: %s\n", paths[i], strerror(errno));
+            return -1;
+        }
+    }
+    // POST is served the file too, as it always has been
+    for (int i = 0; i < config.mount_count; i++) {
+        mount_routes[i].mount = &config.mounts[i];
+        if (router_add(&router, get_head | ROUTER_METHOD_BIT(ROUTER_POST),
+                       config.mounts[i].pattern, &mount_routes[i]) < 0) {
+            fprintf(stderr, "Cannot mount %s at %.*s: %s\n", config.mounts[i].root,
+                    (int)config.mounts[i].prefix_len, config.mounts[i].pattern, strerror(errno));
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void print_usage(const char *program) {
+    fprintf(stderr,
+        "Usage: %s [-p port] [-b backlog] [-w workers] [-c] [-e entries] [-m bytes] [-s bytes] [-k seconds] [-r requests]\n"
+        "          [-T seconds] [-B seconds] [-R seconds] [-H bytes] [-N headers] [-L bytes] [-t file] [-a file] [-f format] [-v]\n"
+        "          [-M path] [-E path] [-D /prefix/=dir]... [-C /prefix=value]... [-z bytes] [-Z bytes] [-j threads]\n"
+        "          [-U] [-P file] [-V host=dir]... [-S file]\n"
+        "  -p port      Port to listen on (default %d)\n"
+        "  -b backlog   Listen backlog (default %d)\n"
+        "  -w workers   Run N SO_REUSEPORT worker processes (0 = one per online CPU)\n"
+        "  -c           Pin each worker to its own CPU\n"
+        "  -e entries   Max open files in the file cache (default %d, 0 = disabled)\n"
+        "  -m bytes     Max bytes of file contents held in memory (default %zu)\n"
+        "  -s bytes     Hold files up to this size in memory (default %ld, 0 = never)\n"
+        "  -k seconds   Keep-alive idle timeout (default %d, 0 = close after each response)\n"
+        "  -r requests  Max requests per keep-alive connection (default %d)\n"
+        "  -T seconds   Time to receive a request head (default %d, 408 beyond)\n"
+        "  -B seconds   Time to receive a request body (default %d)\n"
+        "  -R seconds   Time from a request's first byte until its response is sent (default %d, 0 = none)\n"
+        "  -H bytes     Max request line + headers size (default %zu, 431 beyond)\n"
+        "  -N headers   Max header fields per request (default %d, 431 beyond)\n"
+        "  -L bytes     Max request body size (default %lld, 413 beyond)\n"
+        "  -t file      Extra MIME types (mime.types format) overriding the built-in ones\n"
+        "  -a file      Access log file (default - for stdout, off = no access log)\n"
+        "  -f format    Access log format: common (default), combined or json\n"
+        "  -v           Debug output for each request on stdout (-vv adds headers)\n"
+        "  -M path      Serve Prometheus metrics at this path (default /metrics, off = disabled)\n"
+        "  -E path      Answer health checks at this path with 200 ok\n"
+        "  -D mount     Serve a directory below a URL prefix, e.g. -D /static/=./assets (repeatable;\n"
+        "               ./public is served at / unless a mount takes it)\n"
+        "  -C rule      Cache-Control for files under a path prefix, e.g. -C /static/=max-age=86400\n"
+        "               (repeatable, the longest matching prefix wins)\n"
+        "  -z bytes     gzip files up to this size on the event loop (default %ld)\n"
+        "  -Z bytes     gzip larger files up to this size on a compressor thread (default %ld, 0 = no\n"
+        "               on-the-fly compression; file.br/file.gz siblings are always served)\n"
+        "  -j threads   Open uncached files on a pool of I/O threads per worker (default 0 = on the\n"
+        "               event loop)\n"
+        "  -U           Drive connections with io_uring (multishot accept, provided receive buffers,\n"
+        "               spliced file bodies); falls back to epoll where io_uring is unavailable\n"
+        "  -P file      Serve ./public and ./errors from an asset pack (make pack) mapped at startup,\n"
+        "               with no file system access per request\n"
+        "  -V site      Virtual host: serve dir/public at / and dir/errors for this Host, e.g.\n"
+        "               -V www.example.com=./sites/example or -V '*.example.com=./sites/any' (repeatable;\n"
+        "               mounts, metrics and health routes are shared, other Hosts get the default site)\n"
+        "  -S file      Virtual hosts from a file, one \"host dir\" per line\n"
+        "Send SIGUSR1 to print file cache and memory statistics, SIGHUP to reload error pages and flush the cache.\n",
+        program, PORT, SOMAXCONN, config.cache_entries, config.cache_memory, (long)config.cache_small_file,
+        config.keepalive_timeout, config.max_requests,
+        config.header_timeout, config.body_timeout, config.request_timeout, config.limits.max_header_bytes,
+        config.limits.max_headers, config.limits.max_body,
+        (long)config.compress_inline, (long)config.compress_max);
+}
+
+int main(int argc, char *argv[]) {
+    int opt;
+    while ((opt = getopt(argc, argv, "p:b:w:ce:m:s:k:r:T:B:R:H:N:L:t:a:f:vM:E:D:C:z:Z:j:UP:V:S:h")) != -1) {
+        switch (opt) {
+        case 'p':
+            config.port = atoi(optarg);
+            break;
+        case 'b':
+            config.backlog = atoi(optarg);
+            break;
+        case 'w':
+            config.workers = atoi(optarg);
+            if (config.workers <= 0) {
+                long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+                config.workers = cpu_count > 0 ? (int)cpu_count : 1;
+            }
+            break;
+        case 'c':
+            config.pin_cpus = 1;
+            break;
+        case 'e':
+            config.cache_entries = atoi(optarg);
+            break;
+        case 'm':
+            config.cache_memory = strtoul(optarg, NULL, 10);
+            break;
+        case 's':
+            config.cache_small_file = strtol(optarg, NULL, 10);
+            break;
+        case 'k':
+            config.keepalive_timeout = atoi(optarg);
+            break;
+        case 'r':
+            config.max_requests = atoi(optarg);
+            break;
+        case 'H':
+            config.limits.max_header_bytes = strtoul(optarg, NULL, 10);
+            break;
+        case 'N':
+            config.limits.max_headers = atoi(optarg);
+            break;
+        case 'L':
+            config.limits.max_body = strtoll(optarg, NULL, 10);
+            break;
+        case 't':
+            config.mime_types = optarg;
+            break;
+        case 'a':
+            config.access_log = optarg;
+            break;
+        case 'f':
+            config.access_log_format = access_log_parse_format(optarg);
+            break;
+        case 'v':
+            config.verbosity++;
+            break;
+        case 'M':
+            config.metrics_path = strcmp(optarg, "off") == 0 ? NULL : optarg;
+            break;
+        case 'E':
+            config.health_path = optarg;
+            break;
+        case 'D': {
+            char *dir = strchr(optarg, '=');
+            if (!dir || add_mount(optarg, dir - optarg, dir + 1) < 0) {
+                fprintf(stderr, "Invalid mount: %s (expected /prefix/=dir, at most %d)\n", optarg, MAX_MOUNTS);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        }
+        case 'V': {
+            char *dir = strchr(optarg, '=');
+            if (!dir || add_vhost(optarg, dir - optarg, dir + 1) < 0) {
+                fprintf(stderr, "Invalid virtual host: %s (expected host=dir or *.domain=dir)\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        }
+        case 'S':
+            if (load_vhosts(optarg) < 0) {
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'T':
+            config.header_timeout = atoi(optarg);
+            break;
+        case 'B':
+            config.body_timeout = atoi(optarg);
+            break;
+        case 'R':
+            config.request_timeout = atoi(optarg);
+            break;
+        case 'z':
+            config.compress_inline = strtol(optarg, NULL, 10);
+            break;
+        case 'Z':
+            config.compress_max = strtol(optarg, NULL, 10);
+            break;
+        case 'j':
+            config.io_threads = atoi(optarg);
+            break;
+        case 'U':
+            config.io_uring = 1;
+            break;
+        case 'P':
+            config.asset_pack = optarg;
+            break;
+        case 'C': {
+            char *value = strchr(optarg, '=');
+            if (!value || optarg[0] != '/' || strlen(value + 1) >= MAX_CACHE_CONTROL_LENGTH ||
+                strpbrk(value + 1, "\r\n") || config.cache_control_count == MAX_CACHE_CONTROL_RULES) {
+                fprintf(stderr, "Invalid Cache-Control rule: %s (expected /prefix=value, at most %d)\n",
+                        optarg, MAX_CACHE_CONTROL_RULES);
+                exit(EXIT_FAILURE);
+            }
+            *value = '\0';
+            config.cache_control[config.cache_control_count].prefix = optarg;
+            config.cache_control[config.cache_control_count].value = value + 1;
+            config.cache_control_count++;
+            break;
+        }
+        default:
+            print_usage(argv[0]);
+            exit(opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
+    }
+    if (config.port <= 0 || config.port > 65535 || config.backlog <= 0 ||
+        config.cache_entries < 0 || config.cache_small_file < 0 ||
+        config.compress_inline < 0 || config.compress_max < 0 || config.io_threads < 0 ||
+        config.keepalive_timeout < 0 || config.max_requests <= 0 ||
+        config.header_timeout <= 0 || config.body_timeout <= 0 || config.request_timeout < 0 ||
+        config.limits.max_header_bytes == 0 || config.limits.max_header_bytes >= REQUEST_BUFFER_SIZE ||
+        config.limits.max_headers <= 0 || config.limits.max_headers > HTTP_MAX_HEADERS ||
+        config.limits.max_body < 0 || config.access_log_format < 0) {
+        print_usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    // Writes to a client that has gone away must not kill the server
+    signal(SIGPIPE, SIG_IGN);
+    raise_fd_limit();
+
+    struct sigaction stats_action;
+    memset(&stats_action, 0, sizeof(stats_action));
+    stats_action.sa_handler = handle_stats_signal;
+    sigaction(SIGUSR1, &stats_action, NULL);
+    stats_action.sa_handler = handle_reload_signal;
+    sigaction(SIGHUP, &stats_action, NULL);
+
+    if (config.mime_types) {
+        int loaded = mime_load_overrides(config.mime_types);
+        if (loaded < 0) {
+            perror(config.mime_types);
+            exit(EXIT_FAILURE);
+        }
+        printf("Loaded %d MIME type overrides from %s\n", loaded, config.mime_types);
+    }
+
+    // Mapped once, before the error pages are rendered from it; forked
+    // workers share the mapping
+    if (config.asset_pack) {
+        uint64_t start_ns = metrics_now();
+        if (asset_pack_open(&asset_pack, config.asset_pack) < 0) {
+            fprintf(stderr, "%s: %s\n", config.asset_pack,
+                    errno == EINVAL ? "not an asset pack (rebuild it with make pack)" : strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        asset_entries = counted_calloc(asset_pack.asset_count + 1, sizeof(FileCacheEntry *));
+        if (!asset_entries) {
+            perror("Asset table allocation failed");
+            exit(EXIT_FAILURE);
+        }
+        printf("Asset pack %s: %u assets, %zu bytes, mapped in %.2f ms\n", config.asset_pack,
+               asset_pack.asset_count, asset_pack.size, (metrics_now() - start_ns) / 1e6);
+    }
+
+    // Opened once; forked workers inherit the descriptor
+    if (strcmp(config.access_log, "off") != 0 &&
+        access_log_open(config.access_log, config.access_log_format) < 0) {
+        perror(config.access_log);
+        exit(EXIT_FAILURE);
+    }
+
+    // One shard per worker, shared with every worker so any of them can answer a scrape
+    if (metrics_init(config.workers > 0 ? config.workers : 1) < 0) {
+        perror("Metrics allocation failed");
+        exit(EXIT_FAILURE);
+    }
+
+    // Routes are fixed from here on; forked workers inherit the trie
+    if (build_router() < 0) {
+        exit(EXIT_FAILURE);
+    }
+    printf("Router: %d routes, %d trie nodes\n", router.route_count, router.node_count);
+    if (build_vhosts() < 0) {
+        exit(EXIT_FAILURE);
+    }
+    if (vhost_count > 0) {
+        printf("Virtual hosts: %d sites besides the default one, %d cache entries and %zu bytes each\n",
+               vhost_count, default_host.cache.max_entries, default_host.cache.max_memory);
+    }
+
+    // Pre-render error responses once; forked workers inherit them
+    load_error_pages();
+    buffer_pool_init(&connection_pool, sizeof(Connection), POOL_MAX_FREE);
+    buffer_pool_init(&receive_pool, REQUEST_BUFFER_SIZE, POOL_MAX_FREE);
+    buffer_pool_init(&arena_pool, ARENA_SIZE, POOL_MAX_FREE);
+
+    printf("Phase 8: Event-Driven I/O\n");
+    printf("Request scanning: %s\n", http_scan_implementation());
+    if (config.workers > 0) {
+        printf("Master (pid %d) starting %d workers on port %d, backlog %d%s\n",
+               getpid(), config.workers, config.port, config.backlog,
+               config.pin_cpus ? ", pinned to CPUs" : "");
+        run_master();
+        return 0;
+    }
+
+    int server_fd = create_server_socket(config.port, config.backlog, 0);
+    if (server_fd < 0) {
+        exit(EXIT_FAILURE);
+    }
+    printf("Server listening on port %d...\n", config.port);
+    fflush(stdout);
+
+    run_event_loop(server_fd);
+    close(server_fd);
+    return 0;
+}
@@ -0,0 +1,258 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "router.h"
+
+// A node is reached over a literal edge (prefix) from its parent, or is
+// the parameter or wildcard child of its parent (name). first_bytes[i] is
+// children[i]->prefix[0]: edges out of a node never share a first byte
+struct RouteNode {
+    char *prefix;
+    size_t prefix_len;
+    char *name;
+    RouteNode **children;
+    char *first_bytes;
+    int child_count;
+    RouteNode *param;           // ":name" child
+    RouteNode *wildcard;        // "*name" child (always a leaf)
+    void *targets[ROUTER_METHOD_COUNT];
+    unsigned methods;           // ROUTER_METHOD_BITs with a target
+};
+
+static const char *method_names[ROUTER_METHOD_COUNT] = {
+    "GET", "HEAD", "POST", "PUT", "DELETE", "OPTIONS", "PATCH"
+};
+
+static RouteNode *node_new(Router *router) {
+    RouteNode *node = calloc(1, sizeof(RouteNode));
+    if (node) {
+        router->node_count++;
+    }
+    return node;
+}
+
+static void node_free(RouteNode *node) {
+    if (!node) {
+        return;
+    }
+    for (int i = 0; i < node->child_count; i++) {
+        node_free(node->children[i]);
+    }
+    node_free(node->param);
+    node_free(node->wildcard);
+    free(node->children);
+    free(node->first_bytes);
+    free(node->prefix);
+    free(node->name);
+    free(node);
+}
+
+void router_init(Router *router) {
+    memset(router, 0, sizeof(*router));
+}
+
+void router_free(Router *router) {
+    node_free(router->root);
+    router_init(router);
+}
+
+static int find_child(const RouteNode *node, char c) {
+    const char *hit = node->child_count ? memchr(node->first_bytes, c, node->child_count) : NULL;
+    return hit ? (int)(hit - node->first_bytes) : -1;
+}
+
+static int add_child(RouteNode *node, RouteNode *child) {
+    RouteNode **children = realloc(node->children, (node->child_count + 1) * sizeof(RouteNode *));
+    if (!children) {
+        return -1;
+    }
+    node->children = children;
+    char *first_bytes = realloc(node->first_bytes, node->child_count + 1);
+    if (!first_bytes) {
+        return -1;
+    }
+    node->first_bytes = first_bytes;
+    node->children[node->child_count] = child;
+    node->first_bytes[node->child_count] = child->prefix[0];
+    node->child_count++;
+    return 0;
+}
+
+// Follow (and extend) literal edges for text; returns the node it ends at
+static RouteNode *insert_literal(Router *router, RouteNode *node, const char *text, size_t len) {
+    while (len > 0) {
+        int i = find_child(node, text[0]);
+        if (i < 0) {
+            RouteNode *child = node_new(router);
+            if (!child || !(child->prefix = strndup(text, len))) {
+                free(child);
+                return NULL;
+            }
+            child->prefix_len = len;
+            return add_child(node, child) == 0 ? child : NULL;
+        }
+        RouteNode *child = node->children[i];
+        size_t common = 1;
+        while (common < len && common < child->prefix_len && text[common] == child->prefix[common]) {
+            common++;
+        }
+        if (common < child->prefix_len) {
+            // Split the edge: a new node takes the shared part
+            RouteNode *split = node_new(router);
+            if (!split || !(split->prefix = strndup(child->prefix, common))) {
+                free(split);
+                return NULL;
+            }
+            split->prefix_len = common;
+            memmove(child->prefix, child->prefix + common, child->prefix_len - common + 1);
+            child->prefix_len -= common;
+            if (add_child(split, child) < 0) {
+                return NULL;
+            }
+            node->children[i] = split;
+            child = split;
+        }
+        node = child;
+        text += common;
+        len -= common;
+    }
+    return node;
+}
+
+int router_add(Router *router, unsigned method_mask, const char *pattern, void *target) {
+    if (!pattern || pattern[0] != '/' || method_mask == 0 ||
+        method_mask >= ROUTER_METHOD_BIT(ROUTER_METHOD_COUNT) || !target) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (!router->root && !(router->root = node_new(router))) {
+        errno = ENOMEM;
+        return -1;
+    }
+    RouteNode *node = router->root;
+    int params = 0;
+    const char *p = pattern;
+    while (*p) {
+        if (*p == ':' || *p == '*') {
+            // A whole segment; a wildcard also ends the pattern
+            const char *name = p + 1;
+            const char *end = *p == ':' ? name + strcspn(name, "/") : name + strlen(name);
+            if (end == name || p[-1] != '/' || memchr(name, '/', end - name) ||
+                strcspn(name, ":*") < (size_t)(end - name) || ++params > ROUTER_MAX_PARAMS) {
+                errno = EINVAL;
+                return -1;
+            }
+            RouteNode **slot = *p == ':' ? &node->param : &node->wildcard;
+            if (!*slot) {
+                RouteNode *child = node_new(router);
+                if (!child || !(child->name = strndup(name, end - name))) {
+                    free(child);
+                    errno = ENOMEM;
+                    return -1;
+                }
+                *slot = child;
+            } else if (strlen((*slot)->name) != (size_t)(end - name) ||
+                       strncmp((*slot)->name, name, end - name) != 0) {
+                errno = EINVAL;  // /users/:id and /users/:name can't both be
+                return -1;
+            }
+            node = *slot;
+            p = end;
+        } else {
+            size_t len = strcspn(p, ":*");
+            node = insert_literal(router, node, p, len);
+            if (!node) {
+                errno = ENOMEM;
+                return -1;
+            }
+            p += len;
+        }
+    }
+    if (node->methods & method_mask) {
+        errno = EEXIST;
+        return -1;
+    }
+    for (int method = 0; method < ROUTER_METHOD_COUNT; method++) {
+        if (method_mask & ROUTER_METHOD_BIT(method)) {
+            node->targets[method] = target;
+        }
+    }
+    node->methods |= method_mask;
+    router->route_count++;
+    return 0;
+}
+
+// Match the rest of a path below node: a literal edge first, then the
+// parameter, then the wildcard, backing up when a branch dead-ends
+static const RouteNode *match_below(const RouteNode *node, const char *path, RouteMatch *match) {
+    if (*path == '\0' && node->methods) {
+        return node;
+    }
+    if (*path) {
+        int i = find_child(node, *path);
+        if (i >= 0) {
+            const RouteNode *child = node->children[i];
+            if (strncmp(path, child->prefix, child->prefix_len) == 0) {
+                const RouteNode *found = match_below(child, path + child->prefix_len, match);
+                if (found) {
+                    return found;
+                }
+            }
+        }
+        if (node->param && *path != '/' && match->param_count < ROUTER_MAX_PARAMS) {
+            const char *end = path + strcspn(path, "/");
+            int index = match->param_count++;
+            match->params[index].name = node->param->name;
+            match->params[index].value = path;
+            match->params[index].length = end - path;
+            const RouteNode *found = match_below(node->param, end, match);
+            if (found) {
+                return found;
+            }
+            match->param_count = index;
+        }
+    }
+    if (node->wildcard && match->param_count < ROUTER_MAX_PARAMS) {
+        RouteParam *param = &match->params[match->param_count++];
+        param->name = node->wildcard->name;
+        param->value = path;
+        param->length = strlen(path);
+        return node->wildcard;
+    }
+    return NULL;
+}
+
+int router_match(const Router *router, RouterMethod method, const char *path, RouteMatch *match) {
+    match->target = NULL;
+    match->allowed = 0;
+    match->param_count = 0;
+    const RouteNode *node = router->root ? match_below(router->root, path, match) : NULL;
+    if (!node) {
+        return 0;
+    }
+    match->allowed = node->methods;
+    match->target = (unsigned)method < ROUTER_METHOD_COUNT ? node->targets[method] : NULL;
+    return 1;
+}
+
+int router_method(const char *name, size_t length) {
+    for (int method = 0; method < ROUTER_METHOD_COUNT; method++) {
+        if (strlen(method_names[method]) == length && memcmp(method_names[method], name, length) == 0) {
+            return method;
+        }
+    }
+    return -1;
+}
+
+int router_format_allowed(unsigned allowed, char *buf, size_t size) {
+    size_t len = 0;
+    buf[0] = '\0';
+    for (int method = 0; method < ROUTER_METHOD_COUNT; method++) {
+        if ((allowed & ROUTER_METHOD_BIT(method)) && len < size) {
+            len += snprintf(buf + len, size - len, "%s%s", len ? ", " : "", method_names[method]);
+        }
+    }
+    return len < size ? (int)len : (int)size - 1;
+}
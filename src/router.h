@@ -0,0 +1,78 @@
+#ifndef ROUTER_H
+#define ROUTER_H
+
+#include <stddef.h>
+
+// URL router: a compressed radix trie over route patterns
+//
+// A pattern is a path made of literal text, ":name" parameters matching
+// one non-empty segment (up to the next '/') and an optional final
+// "*name" wildcard matching the rest of the path, possibly empty:
+//
+//     /metrics    /users/:id/posts/:post    /static/*path
+//
+// Literal text shares prefixes along compressed edges, so a lookup walks
+// the path once, comparing each byte about once. Literal edges win over a
+// parameter, and a parameter over a wildcard; when a more specific branch
+// dead-ends further down, the lookup backs up to try the next one. Every
+// route carries a target per method. The trie is built at startup and
+// only read afterwards.
+
+// Methods a route can answer
+typedef enum {
+    ROUTER_GET,
+    ROUTER_HEAD,
+    ROUTER_POST,
+    ROUTER_PUT,
+    ROUTER_DELETE,
+    ROUTER_OPTIONS,
+    ROUTER_PATCH,
+    ROUTER_METHOD_COUNT
+} RouterMethod;
+
+#define ROUTER_METHOD_BIT(method) (1u << (method))
+#define ROUTER_MAX_PARAMS 8
+
+// A parameter or wildcard value: points into the path that was matched
+typedef struct {
+    const char *name;
+    const char *value;
+    size_t length;
+} RouteParam;
+
+typedef struct {
+    void *target;               // NULL if the path matched but not for this method
+    unsigned allowed;           // ROUTER_METHOD_BITs of the methods the path has routes for
+    RouteParam params[ROUTER_MAX_PARAMS];
+    int param_count;
+} RouteMatch;
+
+typedef struct RouteNode RouteNode;
+
+typedef struct {
+    RouteNode *root;
+    int route_count;
+    int node_count;
+} Router;
+
+void router_init(Router *router);
+void router_free(Router *router);
+
+// Add a pattern for the methods in method_mask; returns -1 with errno set:
+// EINVAL for a malformed pattern or one whose parameter names clash with an
+// existing route's at the same place, EEXIST if a method is already routed
+// there, ENOMEM
+int router_add(Router *router, unsigned method_mask, const char *pattern, void *target);
+
+// Match a path (no query string); returns 1 and fills match if some route
+// covers the path - match->target is NULL when none of them takes this
+// method (a 405, see match->allowed) - or 0 if no route matches (a 404)
+int router_match(const Router *router, RouterMethod method, const char *path, RouteMatch *match);
+
+// Method of a request line token, or -1 if the router does not know it
+int router_method(const char *name, size_t length);
+
+// Allowed methods as an Allow header value ("GET, HEAD"); returns the length
+int router_format_allowed(unsigned allowed, char *buf, size_t size);
+
+#endif
@@ -0,0 +1,197 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include "thread_pool.h"
+
+#define MAX_POOL_THREADS 64
+#define DEQUE_SIZE 256              // Power of two
+
+// Bounded deque: the owner pushes and pops at bottom, thieves take from top
+typedef struct {
+    pthread_mutex_t lock;
+    PoolTask *tasks[DEQUE_SIZE];
+    unsigned long top;
+    unsigned long bottom;
+} Deque;
+
+static Deque deques[MAX_POOL_THREADS];
+static int thread_count;
+static unsigned next_deque;         // Round-robin target of the next submit (event loop only)
+
+// Sleeping threads wait for queued to become non-zero
+static pthread_mutex_t idle_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work_available = PTHREAD_COND_INITIALIZER;
+static unsigned long queued;
+
+// Finished tasks, newest first, until the event loop collects them
+static pthread_mutex_t done_lock = PTHREAD_MUTEX_INITIALIZER;
+static PoolTask *done_list;
+static int done_fd = -1;
+
+static unsigned long completed;
+static unsigned long stolen;
+
+static int deque_push(Deque *deque, PoolTask *task) {
+    pthread_mutex_lock(&deque->lock);
+    int pushed = deque->bottom - deque->top < DEQUE_SIZE;
+    if (pushed) {
+        deque->tasks[deque->bottom++ & (DEQUE_SIZE - 1)] = task;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return pushed;
+}
+
+static PoolTask *deque_pop_bottom(Deque *deque) {
+    PoolTask *task = NULL;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->bottom != deque->top) {
+        task = deque->tasks[--deque->bottom & (DEQUE_SIZE - 1)];
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return task;
+}
+
+static PoolTask *deque_steal_top(Deque *deque) {
+    PoolTask *task = NULL;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->bottom != deque->top) {
+        task = deque->tasks[deque->top++ & (DEQUE_SIZE - 1)];
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return task;
+}
+
+// Own deque first, then the others starting with the next thread's
+static PoolTask *take_task(int self) {
+    PoolTask *task = deque_pop_bottom(&deques[self]);
+    for (int i = 1; !task && i < thread_count; i++) {
+        task = deque_steal_top(&deques[(self + i) % thread_count]);
+        if (task) {
+            __atomic_add_fetch(&stolen, 1, __ATOMIC_RELAXED);
+        }
+    }
+    return task;
+}
+
+static void *worker_main(void *arg) {
+    int self = (int)(intptr_t)arg;
+    while (1) {
+        pthread_mutex_lock(&idle_lock);
+        while (queued == 0) {
+            pthread_cond_wait(&work_available, &idle_lock);
+        }
+        pthread_mutex_unlock(&idle_lock);
+
+        PoolTask *task = take_task(self);
+        if (!task) {
+            continue;  // Another thread got there first
+        }
+        pthread_mutex_lock(&idle_lock);
+        queued--;
+        pthread_mutex_unlock(&idle_lock);
+
+        task->run(task);
+        __atomic_add_fetch(&completed, 1, __ATOMIC_RELAXED);
+
+        pthread_mutex_lock(&done_lock);
+        task->next = done_list;
+        done_list = task;
+        pthread_mutex_unlock(&done_lock);
+        uint64_t one = 1;
+        while (write(done_fd, &one, sizeof(one)) < 0 && errno == EINTR) {
+        }
+    }
+    return NULL;
+}
+
+int thread_pool_start(int threads) {
+    if (threads > MAX_POOL_THREADS) {
+        threads = MAX_POOL_THREADS;
+    }
+    done_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (done_fd < 0) {
+        return -1;
+    }
+
+    // Signals stay with the event loop thread, whose epoll_wait() they interrupt
+    sigset_t all_signals;
+    sigset_t previous;
+    sigfillset(&all_signals);
+    pthread_sigmask(SIG_SETMASK, &all_signals, &previous);
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int result = 0;
+    for (int i = 0; i < threads; i++) {
+        pthread_mutex_init(&deques[i].lock, NULL);
+    }
+    for (thread_count = 0; thread_count < threads; thread_count++) {
+        pthread_t thread;
+        result = pthread_create(&thread, &attr, worker_main, (void *)(intptr_t)thread_count);
+        if (result != 0) {
+            break;
+        }
+    }
+    pthread_attr_destroy(&attr);
+
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    if (thread_count == 0) {
+        close(done_fd);
+        done_fd = -1;
+        errno = result;
+        return -1;
+    }
+    return done_fd;
+}
+
+int thread_pool_submit(PoolTask *task) {
+    for (int i = 0; i < thread_count; i++) {
+        Deque *deque = &deques[next_deque++ % thread_count];
+        if (deque_push(deque, task)) {
+            pthread_mutex_lock(&idle_lock);
+            queued++;
+            pthread_cond_signal(&work_available);
+            pthread_mutex_unlock(&idle_lock);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+void thread_pool_collect(void (*done)(PoolTask *task)) {
+    uint64_t count;
+    while (read(done_fd, &count, sizeof(count)) < 0 && errno == EINTR) {
+    }
+    pthread_mutex_lock(&done_lock);
+    PoolTask *list = done_list;
+    done_list = NULL;
+    pthread_mutex_unlock(&done_lock);
+
+    // Reverse into completion order
+    PoolTask *ordered = NULL;
+    while (list) {
+        PoolTask *next = list->next;
+        list->next = ordered;
+        ordered = list;
+        list = next;
+    }
+    while (ordered) {
+        PoolTask *task = ordered;
+        ordered = task->next;
+        done(task);
+    }
+}
+
+unsigned long thread_pool_completed(void) {
+    return __atomic_load_n(&completed, __ATOMIC_RELAXED);
+}
+
+unsigned long thread_pool_stolen(void) {
+    return __atomic_load_n(&stolen, __ATOMIC_RELAXED);
+}
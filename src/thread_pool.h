@@ -0,0 +1,34 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+// Fixed-size pool of threads for blocking work (file system calls) that
+// must not stall the event loop
+//
+// Each thread owns a bounded deque. The event loop deals new tasks to the
+// deques in turn; a thread takes its own newest task first and, when its
+// deque is empty, steals the oldest task from another thread's deque, so a
+// thread stuck on a slow disk does not hold up the tasks queued behind it.
+// A finished task goes onto a completion list and the pool signals an
+// eventfd; the event loop then collects the completions on its own thread.
+// Tasks are intrusive: embed a PoolTask in the job and set run.
+
+typedef struct PoolTask {
+    void (*run)(struct PoolTask *task);     // Called on a pool thread
+    struct PoolTask *next;                  // Completion list (owned by the pool)
+} PoolTask;
+
+// Start the threads in this process (after fork, like the access log
+// writer); returns the eventfd to poll for completions, or -1
+int thread_pool_start(int threads);
+
+// Queue a task; returns -1 if the pool is not running or every deque is full
+int thread_pool_submit(PoolTask *task);
+
+// Drain the eventfd and hand every completed task to done, oldest first
+void thread_pool_collect(void (*done)(PoolTask *task));
+
+// Tasks run so far, and how many of them were stolen from another thread
+unsigned long thread_pool_completed(void);
+unsigned long thread_pool_stolen(void);
+
+#endif
@@ -0,0 +1,114 @@
+#include <string.h>
+#include "timer_wheel.h"
+
+#define ROOT_MASK (TIMER_ROOT_SLOTS - 1)
+#define LEVEL_MASK (TIMER_LEVEL_SLOTS - 1)
+#define WHEEL_SPAN (1ULL << (TIMER_ROOT_BITS + TIMER_UPPER_LEVELS * TIMER_LEVEL_BITS))
+
+// Index of the current tick within an upper level
+static int level_index(uint64_t tick, int level) {
+    return (tick >> (TIMER_ROOT_BITS + level * TIMER_LEVEL_BITS)) & LEVEL_MASK;
+}
+
+static void list_push(Timer **head, Timer *timer) {
+    timer->next = *head;
+    if (*head) {
+        (*head)->pprev = &timer->next;
+    }
+    *head = timer;
+    timer->pprev = head;
+}
+
+static void list_unlink(Timer *timer) {
+    *timer->pprev = timer->next;
+    if (timer->next) {
+        timer->next->pprev = timer->pprev;
+    }
+    timer->next = NULL;
+    timer->pprev = NULL;
+}
+
+// Link a timer into the slot for its expiry, relative to the current tick
+static void place(TimerWheel *wheel, Timer *timer) {
+    uint64_t expires = timer->expires;
+    if (expires < wheel->current) {
+        expires = wheel->current;  // Overdue: the next slot to run
+    }
+    uint64_t delta = expires - wheel->current;
+    if (delta < TIMER_ROOT_SLOTS) {
+        list_push(&wheel->root[expires & ROOT_MASK], timer);
+        return;
+    }
+    if (delta >= WHEEL_SPAN) {
+        expires = wheel->current + WHEEL_SPAN - 1;
+    }
+    for (int level = 0; level < TIMER_UPPER_LEVELS; level++) {
+        if (delta < 1ULL << (TIMER_ROOT_BITS + (level + 1) * TIMER_LEVEL_BITS) || level == TIMER_UPPER_LEVELS - 1) {
+            list_push(&wheel->levels[level][level_index(expires, level)], timer);
+            return;
+        }
+    }
+}
+
+void timer_wheel_init(TimerWheel *wheel, uint64_t now) {
+    memset(wheel, 0, sizeof(*wheel));
+    wheel->current = now;
+}
+
+void timer_wheel_add(TimerWheel *wheel, Timer *timer, uint64_t expires) {
+    if (timer_armed(timer)) {
+        list_unlink(timer);
+    } else {
+        wheel->armed++;
+    }
+    timer->expires = expires;
+    place(wheel, timer);
+}
+
+void timer_wheel_cancel(TimerWheel *wheel, Timer *timer) {
+    if (timer_armed(timer)) {
+        list_unlink(timer);
+        wheel->armed--;
+    }
+}
+
+// Move every timer of an upper level slot down to the slots that now cover it
+// Returns the slot index, so the caller knows whether the level wrapped too
+static int cascade(TimerWheel *wheel, int level) {
+    int index = level_index(wheel->current, level);
+    Timer *list = wheel->levels[level][index];
+    wheel->levels[level][index] = NULL;
+    while (list) {
+        Timer *timer = list;
+        list = timer->next;
+        timer->next = NULL;
+        timer->pprev = NULL;
+        place(wheel, timer);
+    }
+    return index;
+}
+
+void timer_wheel_advance(TimerWheel *wheel, uint64_t now, TimerExpired expired) {
+    while (wheel->current <= now) {
+        int index = wheel->current & ROOT_MASK;
+        if (index == 0) {
+            for (int level = 0; level < TIMER_UPPER_LEVELS && cascade(wheel, level) == 0; level++) {
+            }
+        }
+
+        // Detach the slot first: callbacks may arm timers into it or
+        // cancel timers that are still waiting in it
+        Timer *pending = wheel->root[index];
+        wheel->root[index] = NULL;
+        if (pending) {
+            pending->pprev = &pending;
+        }
+        wheel->current++;
+        while (pending) {
+            Timer *timer = pending;
+            list_unlink(timer);
+            wheel->armed--;
+            expired(timer);
+        }
+    }
+}
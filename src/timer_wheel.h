@@ -0,0 +1,58 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Hierarchical timing wheel for connection deadlines
+//
+// Time is counted in ticks. The first level has 256 slots of one tick each;
+// each of the three levels above has 64 slots, each covering a whole
+// revolution of the level below (256, 16384 and 1048576 ticks). A timer
+// goes into the finest level whose range covers its expiry, and a slot of
+// an upper level is redistributed ("cascaded") into the levels below when
+// the first level wraps around to it. Arming and cancelling are O(1)
+// (timers are intrusive doubly linked list nodes), and advancing costs one
+// slot per tick plus the timers that actually move or expire, however many
+// timers are armed. Expiries further out than the wheel spans (2^26 ticks)
+// are clamped to its far end.
+
+typedef struct Timer {
+    struct Timer *next;
+    struct Timer **pprev;       // Link pointing at this timer; NULL while not armed
+    uint64_t expires;           // Tick
+} Timer;
+
+#define TIMER_ROOT_BITS 8
+#define TIMER_LEVEL_BITS 6
+#define TIMER_ROOT_SLOTS (1 << TIMER_ROOT_BITS)
+#define TIMER_LEVEL_SLOTS (1 << TIMER_LEVEL_BITS)
+#define TIMER_UPPER_LEVELS 3
+
+typedef struct {
+    uint64_t current;           // Next tick to run
+    size_t armed;
+    Timer *root[TIMER_ROOT_SLOTS];
+    Timer *levels[TIMER_UPPER_LEVELS][TIMER_LEVEL_SLOTS];
+} TimerWheel;
+
+// Called for each expired timer, already disarmed; it may arm or cancel any timer
+typedef void (*TimerExpired)(Timer *timer);
+
+void timer_wheel_init(TimerWheel *wheel, uint64_t now);
+
+// Arm (or re-arm) a timer to expire at the given tick; a tick that has
+// already passed expires on the next advance
+void timer_wheel_add(TimerWheel *wheel, Timer *timer, uint64_t expires);
+
+// Disarm a timer; does nothing if it is not armed
+void timer_wheel_cancel(TimerWheel *wheel, Timer *timer);
+
+// Run every tick up to and including now, expiring timers in order of tick
+void timer_wheel_advance(TimerWheel *wheel, uint64_t now, TimerExpired expired);
+
+static inline int timer_armed(const Timer *timer) {
+    return timer->pprev != NULL;
+}
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef URING_H
+#define URING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <linux/io_uring.h>
+
+// Minimal io_uring wrapper on the raw system calls (no liburing)
+//
+// One ring per event loop: SQEs are prepared with the uring_prep_*
+// helpers as the loop goes and submitted all at once by the
+// io_uring_enter() that also waits for completions, so a loop iteration
+// costs one system call however many operations it starts. Receive
+// buffers come from a provided buffer ring: a recv picks a free buffer
+// only once data has arrived, so idle connections hold no memory for it.
+
+typedef struct {
+    int fd;
+    unsigned features;
+
+    // Submission queue
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned sq_mask;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+    unsigned sq_pending;        // Prepared, not yet handed to the kernel
+
+    // Completion queue
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe *cqes;
+
+    void *sq_map;
+    size_t sq_map_size;
+    void *cq_map;
+    size_t cq_map_size;
+    size_t sqes_size;
+
+    // Provided buffer ring (one buffer group)
+    struct io_uring_buf_ring *buf_ring;
+    char *buf_base;
+    size_t buf_map_size;
+    unsigned buf_count;         // Power of two
+    unsigned buf_size;
+    uint16_t buf_group;
+    uint16_t buf_tail;          // Next slot to hand a buffer back in
+
+    unsigned long enters;       // io_uring_enter() calls made
+} Uring;
+
+// Create a ring with room for entries SQEs; returns -1 with errno set
+// (ENOSYS/EPERM where io_uring is unavailable or disabled)
+int uring_init(Uring *ring, unsigned entries);
+void uring_exit(Uring *ring);
+
+// Register count buffers of size bytes as buffer group group
+// (count must be a power of two); returns -1 with errno set
+int uring_setup_buffers(Uring *ring, uint16_t group, unsigned count, unsigned size);
+
+// Provided buffer bid, and handing it back to the kernel once its data is copied out
+static inline char *uring_buffer(Uring *ring, unsigned bid) {
+    return ring->buf_base + (size_t)bid * ring->buf_size;
+}
+void uring_buffer_return(Uring *ring, unsigned bid);
+
+// Next free SQE, zeroed; submits what is queued when the ring is full.
+// Returns NULL only if the kernel refuses the submission
+struct io_uring_sqe *uring_get_sqe(Uring *ring);
+
+// Make room for count SQEs in a row (a linked chain must not be split by
+// a submission); returns -1 with errno set if the kernel refuses
+int uring_reserve(Uring *ring, unsigned count);
+
+// Submit everything prepared and wait until at least one completion is
+// ready or timeout_ms passes (-1 = no timeout); returns -1 with errno set
+// (EINTR when a signal arrived)
+int uring_submit_and_wait(Uring *ring, int timeout_ms);
+
+// Completions: peek the oldest, then mark it consumed
+static inline struct io_uring_cqe *uring_peek_cqe(Uring *ring) {
+    unsigned head = *ring->cq_head;
+    if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+        return NULL;
+    }
+    return &ring->cqes[head & ring->cq_mask];
+}
+
+static inline void uring_cqe_seen(Uring *ring) {
+    __atomic_store_n(ring->cq_head, *ring->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+// Preparation helpers; user_data comes back in the completion
+void uring_prep_accept_multishot(struct io_uring_sqe *sqe, int fd, uint64_t user_data);
+void uring_prep_poll_multishot(struct io_uring_sqe *sqe, int fd, unsigned events, uint64_t user_data);
+void uring_prep_recv_select(struct io_uring_sqe *sqe, int fd, size_t max_len, uint16_t group, uint64_t user_data);
+void uring_prep_sendmsg(struct io_uring_sqe *sqe, int fd, const struct msghdr *msg, int flags, uint64_t user_data);
+void uring_prep_splice(struct io_uring_sqe *sqe, int fd_in, int64_t off_in, int fd_out, size_t len,
+                       uint64_t user_data);
+
+#endif
@@ -0,0 +1,212 @@
+// Generates the MIME type table used by src/mime.c
+//
+// Reads a mime.types file ("media/type ext ext ...") and writes a C header
+// holding a collision-free hash table over the extensions. The table uses
+// hash-and-displace: part of an extension's hash picks a bucket, and the
+// bucket's stored seed, mixed into the hash, picks the slot. Seeds are
+// searched here, biggest buckets first, until every extension has a slot of
+// its own, so a lookup is one pass over the extension and one comparison.
+//
+// Usage: mime_gen src/mime.types > build/mime_table.h
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "../src/mime_hash.h"
+
+#define MAX_ENTRIES 4096
+#define MAX_SEED 65535
+
+typedef struct {
+    char ext[MIME_MAX_EXTENSION + 1];
+    size_t len;
+    uint64_t hash;
+    int type;           // Index into types
+    int bucket;
+} Extension;
+
+static Extension extensions[MAX_ENTRIES];
+static int extension_count;
+static char *types[MAX_ENTRIES];
+static int type_count;
+
+static int load(const char *file_name) {
+    FILE *file = fopen(file_name, "r");
+    if (!file) {
+        perror(file_name);
+        return -1;
+    }
+    char line[1024];
+    int line_number = 0;
+    while (fgets(line, sizeof(line), file)) {
+        line_number++;
+        char *comment = strchr(line, '#');
+        if (comment) {
+            *comment = '\0';
+        }
+        char *saveptr = NULL;
+        char *type = strtok_r(line, " \t\r\n", &saveptr);
+        if (!type) {
+            continue;
+        }
+        if (type_count == MAX_ENTRIES) {
+            fprintf(stderr, "%s:%d: too many types\n", file_name, line_number);
+            return -1;
+        }
+        types[type_count] = strdup(type);
+
+        char *ext;
+        while ((ext = strtok_r(NULL, " \t\r\n", &saveptr)) != NULL) {
+            size_t len = strlen(ext);
+            if (len == 0 || len > MIME_MAX_EXTENSION || extension_count == MAX_ENTRIES) {
+                fprintf(stderr, "%s:%d: bad extension '%s'\n", file_name, line_number, ext);
+                return -1;
+            }
+            for (int i = 0; i < extension_count; i++) {
+                if (strcasecmp(extensions[i].ext, ext) == 0) {
+                    fprintf(stderr, "%s:%d: extension '%s' listed twice\n", file_name, line_number, ext);
+                    return -1;
+                }
+            }
+            Extension *entry = &extensions[extension_count++];
+            entry->hash = mime_hash(ext, len, entry->ext);
+            entry->len = len;
+            entry->type = type_count;
+        }
+        type_count++;
+    }
+    fclose(file);
+    return 0;
+}
+
+// Find a seed for every bucket so all extensions land in distinct slots
+// Returns 0 if some bucket has no working seed at this table size
+static int build(size_t table_size, size_t bucket_count, int *slots, unsigned *seeds) {
+    int order[MAX_ENTRIES];
+    int bucket_sizes[MAX_ENTRIES] = { 0 };
+    for (int i = 0; i < extension_count; i++) {
+        extensions[i].bucket = mime_bucket(extensions[i].hash, bucket_count);
+        bucket_sizes[extensions[i].bucket]++;
+    }
+    for (size_t b = 0; b < bucket_count; b++) {
+        order[b] = (int)b;
+    }
+    // Biggest buckets first, while the table is still empty
+    for (size_t i = 1; i < bucket_count; i++) {
+        for (size_t j = i; j > 0 && bucket_sizes[order[j]] > bucket_sizes[order[j - 1]]; j--) {
+            int swap = order[j];
+            order[j] = order[j - 1];
+            order[j - 1] = swap;
+        }
+    }
+
+    for (size_t i = 0; i < table_size; i++) {
+        slots[i] = -1;
+    }
+    for (size_t i = 0; i < bucket_count; i++) {
+        int bucket = order[i];
+        seeds[bucket] = 0;
+        if (bucket_sizes[bucket] == 0) {
+            continue;
+        }
+        int members[MAX_ENTRIES];
+        int member_count = 0;
+        for (int e = 0; e < extension_count; e++) {
+            if (extensions[e].bucket == bucket) {
+                members[member_count++] = e;
+            }
+        }
+
+        unsigned seed;
+        for (seed = 1; seed <= MAX_SEED; seed++) {
+            size_t placed[MAX_ENTRIES];
+            int ok = 1;
+            for (int m = 0; m < member_count && ok; m++) {
+                const Extension *ext = &extensions[members[m]];
+                placed[m] = mime_slot(ext->hash, seed, table_size);
+                ok = slots[placed[m]] < 0;
+                for (int k = 0; k < m && ok; k++) {
+                    ok = placed[k] != placed[m];
+                }
+            }
+            if (ok) {
+                for (int m = 0; m < member_count; m++) {
+                    slots[placed[m]] = members[m];
+                }
+                seeds[bucket] = seed;
+                break;
+            }
+        }
+        if (seed > MAX_SEED) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void print_string(const char *str) {
+    putchar('"');
+    for (; *str; str++) {
+        if (*str == '"' || *str == '\\') {
+            putchar('\\');
+        }
+        putchar(*str);
+    }
+    putchar('"');
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s mime.types > mime_table.h\n", argv[0]);
+        return 1;
+    }
+    if (load(argv[1]) < 0) {
+        return 1;
+    }
+
+    // Start at a load factor of at most 0.8 and grow until the search succeeds
+    size_t table_size = 16;
+    while (table_size * 4 < (size_t)extension_count * 5) {
+        table_size *= 2;
+    }
+    static int slots[MAX_ENTRIES * 4];
+    static unsigned seeds[MAX_ENTRIES];
+    size_t bucket_count;
+    for (;; table_size *= 2) {
+        if (table_size > MAX_ENTRIES * 4) {
+            fprintf(stderr, "No perfect hash found\n");
+            return 1;
+        }
+        bucket_count = table_size / 4;
+        if (build(table_size, bucket_count, slots, seeds)) {
+            break;
+        }
+    }
+
+    printf("// Generated by tools/mime_gen.c from %s - do not edit\n", argv[1]);
+    printf("// %d extensions in %zu slots, %zu buckets\n\n", extension_count, table_size, bucket_count);
+    printf("#define MIME_TABLE_SIZE %zu\n", table_size);
+    printf("#define MIME_BUCKET_COUNT %zu\n\n", bucket_count);
+
+    printf("static const uint16_t mime_seeds[MIME_BUCKET_COUNT] = {");
+    for (size_t b = 0; b < bucket_count; b++) {
+        printf("%s%u,", b % 12 ? " " : "\n    ", seeds[b]);
+    }
+    printf("\n};\n\n");
+
+    printf("static const MimeEntry mime_table[MIME_TABLE_SIZE] = {\n");
+    for (size_t i = 0; i < table_size; i++) {
+        if (slots[i] < 0) {
+            continue;
+        }
+        const Extension *ext = &extensions[slots[i]];
+        printf("    [%zu] = { ", i);
+        print_string(ext->ext);
+        printf(", %zu, ", ext->len);
+        print_string(types[ext->type]);
+        printf(" },\n");
+    }
+    printf("};\n");
+    return 0;
+}
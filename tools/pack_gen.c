@@ -0,0 +1,300 @@
+// Builds an asset pack (see src/asset_pack.h) for phase8 -P
+//
+// Walks each directory given and packs every regular file below it, in
+// sorted order: its content type, validators and header block, and its
+// compressed variants - file.br / file.gz siblings that are at least as
+// new as the file, else gzip made here for compressible types when it is
+// smaller. ETags come from the size and a hash of the contents, so a
+// rebuild of unchanged files keeps them. The pack is written beside the
+// output and renamed over it, so a server still mapping the old pack is
+// unaffected.
+//
+// Usage: pack_gen -o build/assets.pack ./public ./errors
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "../src/asset_pack.h"
+#include "../src/compress.h"
+#include "../src/mime.h"
+
+static const char *encoding_names[ASSET_ENCODINGS] = { "br", "gzip" };
+static const char *encoding_suffixes[ASSET_ENCODINGS] = { ".br", ".gz" };
+
+static char **paths;
+static size_t path_count;
+static size_t path_capacity;
+
+static int add_path(const char *path) {
+    if (path_count == path_capacity) {
+        size_t capacity = path_capacity ? path_capacity * 2 : 1024;
+        char **grown = realloc(paths, capacity * sizeof(char *));
+        if (!grown) {
+            return -1;
+        }
+        paths = grown;
+        path_capacity = capacity;
+    }
+    paths[path_count] = strdup(path);
+    return paths[path_count++] ? 0 : -1;
+}
+
+// Collect the regular files below dir (following symlinks, like the server's open())
+static int walk(const char *dir) {
+    DIR *stream = opendir(dir);
+    if (!stream) {
+        perror(dir);
+        return -1;
+    }
+    int result = 0;
+    struct dirent *dirent;
+    while (result == 0 && (dirent = readdir(stream)) != NULL) {
+        if (strcmp(dirent->d_name, ".") == 0 || strcmp(dirent->d_name, "..") == 0) {
+            continue;
+        }
+        char path[ASSET_PACK_MAX_PATH];
+        if (snprintf(path, sizeof(path), "%s/%s", dir, dirent->d_name) >= (int)sizeof(path)) {
+            fprintf(stderr, "Skipping %s/%s: path too long\n", dir, dirent->d_name);
+            continue;
+        }
+        struct stat st;
+        if (stat(path, &st) < 0) {
+            perror(path);
+            continue;
+        }
+        if (S_ISDIR(st.st_mode)) {
+            result = walk(path);
+        } else if (S_ISREG(st.st_mode)) {
+            result = add_path(path);
+        }
+    }
+    closedir(stream);
+    return result;
+}
+
+static int compare_paths(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+// Whole file in a malloc'd buffer (never NULL on success, even when empty)
+static char *read_file(const char *path, struct stat *st) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return NULL;
+    }
+    char *data = NULL;
+    if (fstat(fileno(file), st) == 0 && (data = malloc(st->st_size + 1)) != NULL &&
+        fread(data, 1, st->st_size, file) != (size_t)st->st_size) {
+        free(data);
+        data = NULL;
+        errno = EIO;
+    }
+    fclose(file);
+    return data;
+}
+
+// FNV-1a over the contents
+static unsigned long long content_hash(const char *data, size_t len) {
+    unsigned long long hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Append bytes to the data area (plus a NUL when terminate is set)
+static uint64_t data_end;
+static int append(FILE *out, const void *data, size_t len, int terminate, AssetBlob *blob) {
+    blob->offset = data_end;
+    blob->length = len;
+    if (fwrite(data, 1, len, out) != len || (terminate && fputc('\0', out) == EOF)) {
+        return -1;
+    }
+    data_end += len + (terminate ? 1 : 0);
+    return 0;
+}
+
+typedef struct {
+    unsigned long long body_bytes;
+    unsigned long gzipped;
+    unsigned long precompressed;
+} PackStats;
+
+// Write one file's strings, header blocks and bodies, filling in its record
+static int pack_file(FILE *out, const char *path, AssetRecord *record, PackStats *stats) {
+    struct stat st;
+    char *data = read_file(path, &st);
+    if (!data) {
+        perror(path);
+        return -1;
+    }
+    const char *content_type = mime_type_for_path(path);
+    record->hash = asset_pack_hash(path);
+    record->mtime = st.st_mtime;
+    record->compressible = mime_is_compressible(content_type) && st.st_size >= COMPRESS_MIN_SIZE;
+    snprintf(record->etag, sizeof(record->etag), "\"%llx-%016llx\"",
+             (unsigned long long)st.st_size, content_hash(data, st.st_size));
+    struct tm tm;
+    gmtime_r(&st.st_mtime, &tm);
+    strftime(record->last_modified, sizeof(record->last_modified), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+
+    char header[ASSET_PACK_MAX_HEADER];
+    int header_len = asset_format_header(header, sizeof(header), content_type, NULL, st.st_size,
+                                         record->last_modified, record->etag, record->compressible, NULL);
+    if (header_len < 0) {
+        fprintf(stderr, "%s: header block too long\n", path);
+        free(data);
+        return -1;
+    }
+    int result = append(out, path, strlen(path), 1, &record->path) < 0 ||
+                 append(out, content_type, strlen(content_type), 1, &record->content_type) < 0 ||
+                 append(out, header, header_len, 0, &record->header) < 0 ||
+                 append(out, data, st.st_size, 0, &record->body) < 0 ? -1 : 0;
+    stats->body_bytes += st.st_size;
+
+    for (int i = 0; record->compressible && result == 0 && i < ASSET_ENCODINGS; i++) {
+        // A sibling older than the file is stale, as in the server
+        char sibling_path[ASSET_PACK_MAX_PATH + 4];
+        snprintf(sibling_path, sizeof(sibling_path), "%s%s", path, encoding_suffixes[i]);
+        struct stat sibling_st;
+        char *variant = NULL;
+        size_t variant_len = 0;
+        if (stat(sibling_path, &sibling_st) == 0 && S_ISREG(sibling_st.st_mode) &&
+            sibling_st.st_mtime >= st.st_mtime && (variant = read_file(sibling_path, &sibling_st)) != NULL) {
+            variant_len = sibling_st.st_size;
+            stats->precompressed++;
+        } else if (i == ASSET_GZIP && gzip_compress(data, st.st_size, &variant, &variant_len) == 0) {
+            stats->gzipped++;
+        } else {
+            continue;
+        }
+        AssetVariant *packed = &record->variants[i];
+        asset_format_variant_etag(packed->etag, sizeof(packed->etag), record->etag, encoding_names[i]);
+        header_len = asset_format_header(header, sizeof(header), content_type, encoding_names[i], variant_len,
+                                         record->last_modified, packed->etag, 1, NULL);
+        if (header_len < 0) {
+            fprintf(stderr, "%s: header block too long\n", path);
+            result = -1;
+        } else {
+            result = append(out, header, header_len, 0, &packed->header) < 0 ||
+                     append(out, variant, variant_len, 0, &packed->body) < 0 ? -1 : 0;
+        }
+        free(variant);
+    }
+    free(data);
+    if (result < 0) {
+        perror("Pack write failure");
+    }
+    return result;
+}
+
+int main(int argc, char *argv[]) {
+    const char *output = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "o:")) != -1) {
+        if (opt == 'o') {
+            output = optarg;
+        } else {
+            break;
+        }
+    }
+    if (!output || optind >= argc) {
+        fprintf(stderr, "Usage: %s -o output.pack dir [dir...]\n", argv[0]);
+        return 1;
+    }
+
+    // Paths are stored as the server builds them: "./public/index.html"
+    for (int i = optind; i < argc; i++) {
+        char dir[ASSET_PACK_MAX_PATH];
+        int relative = argv[i][0] != '/' && strncmp(argv[i], "./", 2) != 0;
+        snprintf(dir, sizeof(dir), "%s%s", relative ? "./" : "", argv[i]);
+        size_t len = strlen(dir);
+        while (len > 1 && dir[len - 1] == '/') {
+            dir[--len] = '\0';
+        }
+        if (walk(dir) < 0) {
+            return 1;
+        }
+    }
+    qsort(paths, path_count, sizeof(char *), compare_paths);
+
+    // Directories given twice (or nested) yield the same path more than once
+    size_t unique = 0;
+    for (size_t i = 0; i < path_count; i++) {
+        if (unique > 0 && strcmp(paths[unique - 1], paths[i]) == 0) {
+            free(paths[i]);
+            continue;
+        }
+        paths[unique++] = paths[i];
+    }
+    path_count = unique;
+    if (path_count > UINT32_MAX / 4) {
+        fprintf(stderr, "Too many files: %zu\n", path_count);
+        return 1;
+    }
+
+    AssetPackHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ASSET_PACK_MAGIC, sizeof(header.magic));
+    header.version = ASSET_PACK_VERSION;
+    header.asset_count = path_count;
+    header.bucket_count = 1;
+    while (header.bucket_count < path_count * 2) {
+        header.bucket_count *= 2;
+    }
+    if (header.bucket_count <= path_count) {
+        header.bucket_count *= 2;
+    }
+    header.records_offset = (sizeof(header) + 7) & ~(uint64_t)7;
+    header.buckets_offset = header.records_offset + path_count * sizeof(AssetRecord);
+    data_end = header.buckets_offset + header.bucket_count * sizeof(uint32_t);
+
+    AssetRecord *records = calloc(path_count + 1, sizeof(AssetRecord));
+    uint32_t *buckets = calloc(header.bucket_count, sizeof(uint32_t));
+    char temp_path[4096];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", output);
+    FILE *out = fopen(temp_path, "wb");
+    if (!records || !buckets || !out) {
+        perror(out ? "Allocation failure" : temp_path);
+        return 1;
+    }
+
+    // Data area first, then the tables in front of it
+    PackStats stats = { 0, 0, 0 };
+    if (fseeko(out, data_end, SEEK_SET) < 0) {
+        perror(temp_path);
+        return 1;
+    }
+    for (size_t i = 0; i < path_count; i++) {
+        if (pack_file(out, paths[i], &records[i], &stats) < 0) {
+            fclose(out);
+            unlink(temp_path);
+            return 1;
+        }
+        uint32_t slot = records[i].hash & (header.bucket_count - 1);
+        while (buckets[slot] != 0) {
+            slot = (slot + 1) & (header.bucket_count - 1);
+        }
+        buckets[slot] = i + 1;
+    }
+    header.size = data_end;
+    if (fseeko(out, 0, SEEK_SET) < 0 || fwrite(&header, sizeof(header), 1, out) != 1 ||
+        fseeko(out, header.records_offset, SEEK_SET) < 0 ||
+        fwrite(records, sizeof(AssetRecord), path_count, out) != path_count ||
+        fwrite(buckets, sizeof(uint32_t), header.bucket_count, out) != header.bucket_count ||
+        fclose(out) != 0 || rename(temp_path, output) < 0) {
+        perror(output);
+        unlink(temp_path);
+        return 1;
+    }
+    printf("Packed %zu files (%llu bytes, %lu gzip'ed here, %lu precompressed variants) into %s, %llu bytes\n",
+           path_count, stats.body_bytes, stats.gzipped, stats.precompressed, output,
+           (unsigned long long)header.size);
+    return 0;
+}